@@ -0,0 +1,177 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Both inputs are parsed concurrently by one thread each through the batch
+// interface with library owned batches, into which the parsed clauses are
+// copied.  As the next batch reuses these arrays, a thread waits after
+// handing over a batch until the comparing (main) thread has consumed it.
+// Thus parsing the next batch of an input never overlaps comparing its
+// current batch, but one input can be parsed while the batch of the other
+// input is still compared.  Batch boundaries of the two inputs do not have
+// to match.  The headers are only compared after all clauses matched, as
+// with '--compact', '--fix-header' or options removing clauses the header
+// to be written is only known at the end.
+
+#include "compare.h"
+#include "normalizecnf.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+struct side {
+  const char *name;
+  normalizer *n;
+  int variables, clauses;
+  pthread_t thread;
+  normalizer_batch batch;
+  int res;     // of last batch: clauses, zero at end, negative on error
+  bool ready;  // batch handed over to comparing thread
+  size_t next; // next clause in batch to compare
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool stop;
+
+static void *parse(void *ptr) {
+  struct side *s = ptr;
+  for (;;) {
+    int res = normalizer_next_batch(s->n, &s->batch);
+    pthread_mutex_lock(&lock);
+    s->res = res;
+    s->ready = true;
+    pthread_cond_broadcast(&cond);
+    while (s->ready && !stop)
+      pthread_cond_wait(&cond, &lock);
+    bool done = stop || res <= 0;
+    pthread_mutex_unlock(&lock);
+    if (done)
+      return 0;
+  }
+}
+
+static void take(struct side *s) {
+  pthread_mutex_lock(&lock);
+  while (!s->ready)
+    pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  s->next = 0;
+}
+
+static void release(struct side *s) {
+  pthread_mutex_lock(&lock);
+  s->ready = false;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+}
+
+// Make sure the current batch has a clause left (or ended) and returns
+// false on errors.
+
+static bool refill(struct side *s) {
+  while (s->res > 0 && s->next == s->batch.size) {
+    release(s);
+    take(s);
+  }
+  if (s->res >= 0)
+    return true;
+  fprintf(stderr, "normalize: error in '%s': %s\n", s->name,
+          normalizer_error(s->n));
+  return false;
+}
+
+static const int *clause(struct side *s, size_t *size) {
+  size_t i = s->next++;
+  size_t begin = i ? s->batch.ends[i - 1] : 0;
+  *size = s->batch.ends[i] - begin;
+  return s->batch.literals + begin;
+}
+
+static int compare_clauses(struct side *a, struct side *b) {
+  take(a);
+  take(b);
+  for (size_t i = 1;; i++) {
+    if (!refill(a) || !refill(b))
+      return 2;
+    if (!a->res || !b->res) {
+      if (!a->res && !b->res)
+        return 0;
+      printf("'%s' and '%s' differ in clause %zu: end of '%s'\n", a->name,
+             b->name, i, (a->res ? b : a)->name);
+      return 1;
+    }
+    size_t size_a, size_b;
+    const int *lits_a = clause(a, &size_a), *lits_b = clause(b, &size_b);
+    size_t size = size_a < size_b ? size_a : size_b;
+    for (size_t j = 0; j != size; j++)
+      if (lits_a[j] != lits_b[j]) {
+        printf("'%s' and '%s' differ in clause %zu at literal %zu: "
+               "%d and %d\n",
+               a->name, b->name, i, j + 1, lits_a[j], lits_b[j]);
+        return 1;
+      }
+    if (size_a != size_b) {
+      printf("'%s' and '%s' differ in clause %zu: %zu and %zu literals\n",
+             a->name, b->name, i, size_a, size_b);
+      return 1;
+    }
+  }
+}
+
+static bool open_side(struct side *s, int size_options, char **options) {
+  if (!(s->n = normalizer_new())) {
+    fputs("normalize: error: out-of-memory allocating normalizer\n",
+          stderr);
+    return false;
+  }
+  for (int i = 0; i != size_options; i++)
+    if (normalizer_option(s->n, options[i]))
+      goto ERROR;
+  if (normalizer_open_input(s->n, s->name))
+    goto ERROR;
+  return true;
+ERROR:
+  fprintf(stderr, "normalize: error in '%s': %s\n", s->name,
+          normalizer_error(s->n));
+  return false;
+}
+
+int compare(const char *a, const char *b, int size_options, char **options) {
+  struct side sides[2] = {{.name = a}, {.name = b}};
+  int res = 2;
+  if (!open_side(sides, size_options, options) ||
+      !open_side(sides + 1, size_options, options))
+    goto DONE;
+  unsigned started = 0;
+  while (started != 2 &&
+         !pthread_create(&sides[started].thread, 0, parse, sides + started))
+    started++;
+  if (started == 2)
+    res = compare_clauses(sides, sides + 1);
+  else
+    fputs("normalize: error: could not start parser thread\n", stderr);
+  pthread_mutex_lock(&lock);
+  stop = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  for (unsigned i = 0; i != started; i++)
+    pthread_join(sides[i].thread, 0);
+  if (res)
+    goto DONE;
+  for (unsigned i = 0; i != 2; i++)
+    normalizer_header(sides[i].n, &sides[i].variables, &sides[i].clauses);
+  if (sides[0].variables != sides[1].variables ||
+      sides[0].clauses != sides[1].clauses) {
+    printf("'%s' and '%s' differ in header: 'p cnf %d %d' and "
+           "'p cnf %d %d'\n",
+           a, b, sides[0].variables, sides[0].clauses, sides[1].variables,
+           sides[1].clauses);
+    res = 1;
+  } else
+    printf("'%s' and '%s' are equal\n", a, b);
+DONE:
+  for (unsigned i = 0; i != 2; i++)
+    if (sides[i].n)
+      normalizer_delete(sides[i].n);
+  return res;
+}
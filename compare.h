@@ -0,0 +1,12 @@
+#ifndef _compare_h_INCLUDED
+#define _compare_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Compare the normalized clauses of two inputs ('--compare') after
+// applying the given options to both.  Returns zero if they are equal, one
+// if they differ and two on errors (as 'cmp').
+
+int compare(const char *a, const char *b, int size_options, char **options);
+
+#endif
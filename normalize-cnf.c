@@ -1,250 +1,246 @@
 // Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
 
 // This is a tool to normalize CNFs in DIMACS format by removing all
-// comments and white-space (it also checks for syntax issues).
+// comments and white-space (it also checks for syntax issues).  It is a
+// thin command line front-end to the library in 'normalizecnf.c'.
 
 // clang-format off
 
 static const char * usage =
-"usage: normalize [ -h ] [ <input> [ <output> ] ]\n"
+"usage: normalize [ <option> ... ] [ <input> [ <output> ] ]\n"
+"       normalize [ <option> ... ] --serve <socket>\n"
+"       normalize [ <option> ... ] --watch <dir> <output-dir>\n"
+"       normalize [ <option> ... ] --compare <input> <input>\n"
 "\n"
-"  -h | --help  print this command line option summary\n"
-"  -g | --gbd   GBD normalize (no 'p' line, strip last '\\n', '\\n' -> ' ')\n"
-"  <input>      input file expected to be in DIMACS format\n"
-"  <output>     output file produced in DIMACS format\n"
+"where '<option>' is one of the following\n"
+"\n"
+"  -h | --help          print this command line option summary\n"
+"  -g | --gbd           GBD normalize (no 'p' line, strip last '\\n',\n"
+"                       and replace '\\n' by ' ')\n"
+"  --features=<file>    write clause statistics features in JSON format\n"
+"  --occurrences=<file> write positive and negative variable occurrences\n"
+"  --compact            rename variables densely in first-occurrence order\n"
+"  --map=<file>         write '<new> <old>' variable mapping of '--compact'\n"
+"  --sort-literals      sort literals in clauses and remove duplicates\n"
+"  --remove-tautologies remove tautological clauses (implies sorting)\n"
+"  --sort-clauses       sort clauses by size and then lexicographically\n"
+"                       (implies '--sort-literals')\n"
+"  --dedup              remove duplicated clauses (implies sorting literals)\n"
+"  --fingerprint        write hash invariant under clause and literal order\n"
+"  --fingerprint=<r>    ... and under variable renaming (<r> refinements)\n"
+"  --hash               compute fingerprint of output for statistics\n"
+"  --fix-header         write header with actual variables and clauses\n"
+"  --index=<file>       write binary index of clause positions in output\n"
+"  --index-block=<k>    index every '<k>'-th clause (default 1024)\n"
+"  --binary             write binary format (input format is detected)\n"
+"  --csr                write memory-mappable clause database\n"
+"  --delta              write delta encoded binary format (sorts literals)\n"
+"  --shards=<n>         split clauses into '<n>' output files\n"
+"  --shard-by=<method>  'round-robin' (default), 'range' or 'hash'\n"
+"  --sample=<p>|<n>     keep random fraction '<p>' of clauses (e.g. '0.1'\n"
+"                       or '10%') or at most '<n>' clauses\n"
+"  --seed=<s>           seed for '--sample' (default 0)\n"
+"  --memory-limit=<n>   limit memory for buffering and sampling clauses\n"
+"                       (default 1g) in bytes (suffix 'k', 'm' or 'g')\n"
+"                       and spill to disk\n"
+"  --temp-dir=<dir>     directory for temporary files (default '/tmp')\n"
+"  --stats              print statistics including peak memory usage\n"
+"  --header             only parse and print header (stops decompression)\n"
+"  --tar                read input as tar archive (implied by '.tar' and\n"
+"                       '.tar.xz' suffix) and write members to directory\n"
+"  --compare <a> <b>    compare normalized clauses of '<a>' and '<b>'\n"
+"  --serve <socket>     run as daemon serving requests on a Unix socket\n"
+"  --watch <dir> <output-dir>\n"
+"                       normalize files dropped into '<dir>'\n"
+"  --workers=<n>        number of worker threads (default processors)\n"
+"\n"
+"and\n"
+"\n"
+"  <input>              input file expected to be in DIMACS format\n"
+"  <output>             output file produced in DIMACS format\n"
 "\n"
 "The file arguments can be '-' to denote '<stdin>' respectively '<stdout>\n"
 "which are also the default files if not specified.  If further the path\n"
 "of a file has a '.xz' suffix, it is decompressed respectively compressed\n"
 "using 'xz' on-the-fly (through a pipe).\n"
+"\n"
+"With '--shard-by=range' consecutive clauses are split according to the\n"
+"number of clauses in the header, thus it can not be combined with options\n"
+"removing clauses ('--dedup', '--remove-tautologies' and '--sample') nor\n"
+"with '--fix-header'.\n"
+"\n"
+"For tar archives '<output>' is an existing directory.  Each regular file\n"
+"member is normalized to the same relative path in it and '<member> <hash>'\n"
+"is printed (the hash as with '--hash').  The archive is read as stream,\n"
+"but members have to be uncompressed.\n"
+"\n"
+"With '--compare' the first differing clause or literal is printed (as\n"
+"'cmp' with exit code one, while two denotes errors) and otherwise\n"
+"differing headers as they would be written.  Both inputs are parsed\n"
+"concurrently with options applied, except that '--sort-clauses' and\n"
+"'--dedup' are rejected.  No output is written.\n"
+"\n"
+"With '--serve' each connection to '<socket>' sends one request of NUL\n"
+"terminated arguments (options, input and output) ended by an empty\n"
+"argument.  Open descriptors passed with 'SCM_RIGHTS' replace missing or\n"
+"'-' files in order.  The given options are applied before those of the\n"
+"request.  The response is 'ok' followed by the statistics lines of\n"
+"'--stats' or 'error <status> <message>'.  Memory limits are per worker.\n"
+"\n"
+"With '--watch' every file closed after writing or moved into '<dir>'\n"
+"(except hidden files) is normalized to the same name in '<output-dir>'\n"
+"by the worker pool.  The statistics including the hash ('--hash') are\n"
+"written to '<name>.stats' next to it and '<path> <hash>' is printed.\n"
 ;
 
 // clang-format on
 
-#include <assert.h>
+#include "compare.h"
+#include "normalizecnf.h"
+#include "pool.h"
+#include "serve.h"
+#include "tar.h"
+#include "watch.h"
+
 #include <ctype.h>
-#include <limits.h>
-#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 
-static const char *input_path, *output_path;
-static FILE *input_file, *output_file;
-static int close_input, close_output;
-static bool gbd;
-
-static void die(const char *fmt, ...) {
-  fprintf(stderr, "normalize: error in '%s': ", input_path);
-  va_list ap;
-  va_start(ap, fmt);
-  vfprintf(stderr, fmt, ap);
-  va_end(ap);
-  fputc('\n', stderr);
+static void die(normalizer *n, const char *path) {
+  if (path)
+    fprintf(stderr, "normalize: error in '%s': %s\n", path,
+            normalizer_error(n));
+  else
+    fprintf(stderr, "normalize: error: %s\n", normalizer_error(n));
+  normalizer_delete(n);
   exit(1);
 }
 
-static bool has_suffix(const char *a, const char *b) {
-  size_t k = strlen(a), l = strlen(b);
-  return k >= l && !strcmp(a + k - l, b);
+static bool parse_workers(const char *arg, unsigned *workers) {
+  const char *p = arg + 10;
+  unsigned res = 0;
+  do {
+    if (!isdigit((unsigned char) *p) || res > 10000)
+      return false;
+    res = 10 * res + (*p - '0');
+  } while (*++p);
+  if (!res || res > 10000)
+    return false;
+  *workers = res;
+  return true;
 }
 
-static bool exists_file(const char *path) {
-  struct stat buf;
-  return !stat(path, &buf);
+static void error(normalizer *n, const char *msg, const char *arg) {
+  fprintf(stderr, "normalize: error: %s", msg);
+  if (arg)
+    fprintf(stderr, " '%s'", arg);
+  fputc('\n', stderr);
+  normalizer_delete(n);
+  exit(1);
 }
 
 int main(int argc, char **argv) {
+  const char *input_path = 0, *output_path = 0, *socket_path = 0;
+  const char *watch_dir = 0, *watch_output_dir = 0;
+  const char *compare_a = 0, *compare_b = 0;
+  unsigned workers = 0;
+  bool stats = false, tar = false, header = false;
+  normalizer *n = normalizer_new();
+  char **options = malloc(argc * sizeof *options);
+  int size_options = 0;
+  if (!n || !options) {
+    fputs("normalize: error: out-of-memory allocating normalizer\n",
+          stderr);
+    exit(1);
+  }
   for (int i = 1; i != argc; i++) {
     const char *arg = argv[i];
     if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
       fputs(usage, stdout);
+      normalizer_delete(n);
       exit(0);
-    } else if (!strcmp(arg, "-g") || !strcmp(arg, "--gbd"))
-      gbd = true;
-    else if (output_path)
-      die("too many files");
+    } else if (!strcmp(arg, "--stats"))
+      stats = true;
+    else if (!strcmp(arg, "--tar"))
+      tar = true;
+    else if (!strcmp(arg, "--header"))
+      header = true;
+    else if (!strcmp(arg, "--serve")) {
+      if (++i == argc)
+        error(n, "argument to '--serve' missing", 0);
+      socket_path = argv[i];
+    } else if (!strcmp(arg, "--compare")) {
+      if (argc - i < 3)
+        error(n, "arguments to '--compare' missing", 0);
+      compare_a = argv[++i];
+      compare_b = argv[++i];
+    } else if (!strcmp(arg, "--watch")) {
+      if (argc - i < 3)
+        error(n, "arguments to '--watch' missing", 0);
+      watch_dir = argv[++i];
+      watch_output_dir = argv[++i];
+    } else if (!strncmp(arg, "--workers=", 10)) {
+      if (!parse_workers(arg, &workers))
+        error(n, "invalid option", arg);
+    } else if (arg[0] == '-' && arg[1]) {
+      if (normalizer_option(n, arg))
+        die(n, 0);
+      options[size_options++] = argv[i];
+    } else if (output_path)
+      error(n, "too many files", 0);
     else if (input_path)
       output_path = arg;
     else
       input_path = arg;
   }
-  if (!input_path || !strcmp(input_path, "-")) {
-    input_file = stdin;
-    input_path = "<stdin>";
-    close_input = 0;
-  } else if (!exists_file(input_path))
-    die("input file '%s' does not exist", input_path);
-  else if (has_suffix(input_path, ".xz")) {
-    size_t len = strlen(input_path) + 16;
-    char *cmd = malloc(len);
-    snprintf(cmd, len, "xz -d -c %s", input_path);
-    input_file = popen(cmd, "r");
-    free(cmd);
-    close_input = 2;
-  } else {
-    input_file = fopen(input_path, "r");
-    close_input = 1;
-  }
-  if (!input_file)
-    die("can not read input file '%s'", input_path);
-  int ch;
-  for (;;) {
-    ch = getc(input_file);
-    if (ch == 'c') {
-      while ((ch = getc(input_file)) != '\n')
-        if (ch == EOF)
-        END_OF_FILE_IN_COMMENT:
-          die("end-of-file in comment");
-    } else if (ch == ' ' || ch == '\t' || ch == '\r') {
-      while ((ch = getc(input_file)) != '\n')
-        if (ch == EOF)
-          die("unexpected end-of-file after white-space");
-    } else if (ch != '\n')
-      break;
+  if (socket_path && watch_dir)
+    error(n, "can not combine '--serve' and '--watch'", 0);
+  if (compare_a) {
+    if (input_path)
+      error(n, "unexpected file", input_path);
+    normalizer_delete(n);
+    int res = compare(compare_a, compare_b, size_options, options);
+    free(options);
+    return res;
   }
-  if (ch != 'p')
-    die("expected 'p cnf ...' header or 'c' comment");
-  for (const char *p = " cnf "; *p; p++)
-    if (*p != getc(input_file))
-      die("invalid 'p cnf ...' header");
-  ch = getc(input_file);
-  if (!isdigit(ch))
-  INVALID_VARIABLES:
-    die("invalid number of variables");
-  int variables = ch - '0';
-  while (isdigit(ch = getc(input_file))) {
-    if (INT_MAX / 10 < variables)
-      goto INVALID_VARIABLES;
-    variables *= 10;
-    int digit = ch - '0';
-    if (INT_MAX - digit < variables)
-      goto INVALID_VARIABLES;
-    variables += digit;
+  if (socket_path || watch_dir) {
+    if (input_path)
+      error(n, "unexpected file", input_path);
+    normalizer_delete(n);
+    if (!workers)
+      workers = default_workers();
+    int res = socket_path ? serve(socket_path, workers, size_options, options)
+                          : watch(watch_dir, watch_output_dir, workers,
+                                  size_options, options);
+    free(options);
+    return res;
   }
-  if (ch != ' ')
-    die("expected space in header after variables");
-  ch = getc(input_file);
-  if (!isdigit(ch))
-  INVALID_CLAUSES:
-    die("invalid number of clauses");
-  int clauses = ch - '0';
-  while (isdigit(ch = getc(input_file))) {
-    if (INT_MAX / 10 < clauses)
-      goto INVALID_CLAUSES;
-    clauses *= 10;
-    int digit = ch - '0';
-    if (INT_MAX - digit < clauses)
-      goto INVALID_CLAUSES;
-    clauses += digit;
+  free(options);
+  if (tar || (input_path && is_tar_path(input_path))) {
+    int res = normalize_tar(n, input_path, output_path, stats);
+    normalizer_delete(n);
+    return res;
   }
-  if (ch == '\r')
-    ch = getc(input_file);
-  if (ch == ' ' || ch == '\t') {
-    while ((ch = getc(input_file)) != '\n')
-      if (ch != ' ' && ch != '\t' && ch != '\r')
-      EXPECTED_NEW_LINE_AFTER_HEADER:
-        die("expected white-space and a new-line after clauses");
-  } else if (ch != '\n')
-    goto EXPECTED_NEW_LINE_AFTER_HEADER;
-  if (!output_path || !strcmp(output_path, "-")) {
-    output_file = stdout;
-    close_output = 0;
-  } else if (has_suffix(output_path, ".xz")) {
-    size_t len = strlen(output_path) + 16;
-    char *cmd = malloc(len);
-    snprintf(cmd, len, "xz -e -c > %s", output_path);
-    output_file = popen(cmd, "w");
-    free(cmd);
-    close_output = 2;
-  } else {
-    output_file = fopen(output_path, "w");
-    close_output = 1;
-  }
-  if (!output_file)
-    die("can not write output file '%s'", output_path);
-  if (!gbd)
-    fprintf(output_file, "p cnf %d %d\n", variables, clauses);
-  int parsed = 0, lit = 0;
-  bool first = true;
-  for (;;) {
-    ch = getc(input_file);
-    if (ch == EOF) {
-      if (lit)
-        die("zero at end of last clause missing");
-      if (parsed < clauses)
-        die("clause missing");
-      break;
-    }
-    if (ch == 'c') {
-      while ((ch = getc(input_file)) != '\n')
-        if (ch == EOF) {
-          if (lit || parsed < clauses)
-            goto END_OF_FILE_IN_COMMENT;
-          else
-            break;
-        }
-      continue;
-    }
-    if (ch == '\r')
-      ch = getc(input_file);
-    if (ch == ' ' || ch == '\n' || ch == '\t')
-      continue;
-    int sign = 1;
-    if (ch == '-') {
-      ch = getc(input_file);
-      sign = -1;
-    }
-    if (!isdigit(ch))
-    INVALID_LITERAL:
-      die("invalid literal");
-    if (gbd && !lit) {
-      if (first)
-        first = false;
-      else
-        fputc(' ', output_file);
-    }
-    lit = ch - '0';
-    while (isdigit(ch = getc(input_file))) {
-      if (INT_MAX / 10 < lit)
-        goto INVALID_LITERAL;
-      lit *= 10;
-      int digit = ch - '0';
-      if (INT_MAX - digit < lit)
-        goto INVALID_LITERAL;
-      lit += digit;
-    }
-    if (lit > variables)
-      goto INVALID_LITERAL;
-    if (ch == '\r')
-      ch = getc(input_file);
-    if (ch != ' ' && ch != '\n' && ch != '\t' && ch != 'c' && ch != EOF)
-      die("expected white-space after literal");
-    if (ch == 'c') {
-      while ((ch = getc(input_file)) != '\n')
-        if (ch == EOF) {
-          if (lit || parsed < clauses)
-            goto END_OF_FILE_IN_COMMENT;
-          else
-            break;
-        }
-    }
-    if (lit)
-      fprintf(output_file, "%d ", sign * lit);
-    else if (parsed++ == clauses)
-      die("too many clauses");
-    else if (gbd)
-      fputc('0', output_file);
-    else
-      fputs("0\n", output_file);
+  const char *name = input_path && strcmp(input_path, "-") ? input_path
+                                                           : "<stdin>";
+  if (header) {
+    if (output_path)
+      error(n, "unexpected output file with '--header'", output_path);
+    int variables, clauses;
+    if (normalizer_open_input(n, input_path) ||
+        normalizer_header(n, &variables, &clauses))
+      die(n, name);
+    printf("p cnf %d %d\n", variables, clauses);
+    normalizer_delete(n);
+    return 0;
   }
-  if (close_input == 1)
-    fclose(input_file);
-  if (close_input == 2)
-    pclose(input_file);
-  if (close_output)
-    fclose(output_file);
+  if (normalizer_open_input(n, input_path) ||
+      normalizer_open_output(n, output_path) || normalizer_run(n))
+    die(n, name);
+  if (stats)
+    normalizer_print_statistics(n, stderr);
+  normalizer_delete(n);
   return 0;
 }
@@ -0,0 +1,2851 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Library part of 'normalize-cnf' which parses CNFs in DIMACS (or binary)
+// format, checks them for syntax issues and writes them normalized.
+
+#define _GNU_SOURCE
+
+#include "normalizecnf.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include <unistd.h>
+
+// Optional static user-level tracepoints (USDT) enabled with './configure
+// --usdt'.  They can be listed with 'bpftrace -l "usdt:./normalize-cnf:*"'
+// and otherwise compile to nothing.
+
+#ifdef USDT
+#include <sys/sdt.h>
+#define PROBE2(NAME, A, B) DTRACE_PROBE2(normalize, NAME, A, B)
+#define PROBE3(NAME, A, B, C) DTRACE_PROBE3(normalize, NAME, A, B, C)
+#else
+#define PROBE2(NAME, A, B) do { (void) (A), (void) (B); } while (0)
+#define PROBE3(NAME, A, B, C) \
+  do { (void) (A), (void) (B), (void) (C); } while (0)
+#endif
+
+// The clause index ('--index=<file>') allows to seek to a clause without
+// parsing the output.  It is written in the following binary format, where
+// all numbers are 64-bit unsigned integers in little-endian byte order:
+//
+//   "NCNFIDX1"                 8 bytes magic string
+//   <block-size>               number of clauses per block
+//   <clauses>                  number of clauses in output
+//   <blocks>                   number of blocks
+//   <offset> <clauses> <literals>   for each block
+//
+// The offset is the byte position of the first literal of the first clause
+// in the block in the (uncompressed) output.  All blocks except for the
+// last one contain exactly '<block-size>' clauses.
+
+struct block {
+  uint64_t offset, clauses, literals;
+};
+
+// Sharding ('--shards=<n>') distributes clauses over several output files,
+// which are named by inserting '-<i>' before the first dot of the base name
+// of the output path.  The body of each shard is spooled to a temporary
+// file until its number of clauses is known.  Splitting by range uses the
+// number of clauses in the header and thus can not be combined with
+// options which remove clauses or repair the header.
+
+enum shard_method { ROUND_ROBIN, RANGE, HASH };
+
+struct shard {
+  FILE *file;
+  int emitted;
+  size_t body_bytes;
+};
+
+// Clause records '<size> <literal> ...' which have to be kept (for sorting
+// and deduplication) are allocated from a chunked bump arena, thus never
+// move and allocation is off the hot path.  Resetting the arena keeps its
+// chunks for reuse (also across files).  Large chunks are mapped directly
+// and advised to be backed by huge pages.  If the arena has a limit, it
+// refuses to allocate another chunk exceeding it (unless it is empty) and
+// the caller has to spill its records.
+
+struct chunk {
+  struct chunk *next;
+  int *begin, *end;
+  bool mapped;
+};
+
+struct arena {
+  struct chunk *chunks, *last, *current;
+  int *top;
+  size_t allocated, used, limit;
+};
+
+// Clauses of a reservoir sample ('--sample=<n>') are stored as records
+// together with their sequence number to restore their original order.
+// Spilled records are only referenced by their offset in the temporary
+// file.
+
+struct sample {
+  int sequence;
+  int *record; // zero if spilled
+  off_t offset;
+};
+
+// Merging sorted runs reads the current clause of each run into its own
+// buffer (also used to read back the fingerprint spool and spilled clauses
+// of '--dedup', which are preceded by their sequence number).
+
+struct merger {
+  int *clause;
+  size_t capacity;
+  FILE *run;
+  int sequence;
+};
+
+// If the hash table of '--dedup' exceeds the memory limit, clauses which
+// are not found in the table are spilled to one of 'PARTITIONS' files
+// selected by hash, which are deduplicated recursively in the same way.
+
+#define PARTITIONS 64
+#define MAX_LEVELS 8
+
+// Options are kept separate from the state of normalizing a file.
+
+struct options {
+  bool gbd;
+  bool compact;
+  bool sort_literals, remove_tautologies;
+  bool sort_clauses;
+  bool dedup;
+  bool fix_header;
+  bool fingerprint, hash;
+  bool binary_output, delta_output;
+  bool csr;
+  int fingerprint_rounds;
+  char *features_path;
+  char *occurrences_path;
+  char *map_path;
+  char *index_path;
+  char *temp_dir;
+  size_t index_block;
+  size_t memory_limit;
+  double sample_fraction;
+  size_t sample_count;
+  uint64_t seed;
+  unsigned size_shards;
+  enum shard_method shard_method;
+};
+
+struct normalizer {
+  struct options opts;
+
+  // Errors are recorded and then jump back to the API function.
+
+  int status;
+  char error[256];
+  jmp_buf jump;
+
+  char *input_path, *output_path;
+  FILE *input_file, *output_file, *body_file;
+  int variables, clauses, parsed;
+  size_t body_bytes;
+  char *spool_buffer;
+  size_t spool_buffer_size;
+  bool memory_spool;
+  int close_input, output_mode;
+  pid_t input_pid, output_pid;
+  bool header_parsed, body_started, body_parsed, pending_clause;
+  bool binary_input, delta_input;
+
+  // Instance features gathered while normalizing ('--features=<file>').
+
+  size_t literals, positive, negative, empty, binary, ternary;
+  size_t *histogram, histogram_size;
+  int max_variable;
+
+  // Per-variable occurrence counts ('--occurrences=<file>').  If only the
+  // features are requested we just need a bit-set to find unused
+  // variables.
+
+  unsigned (*occurrences)[2];
+  unsigned char *used;
+  size_t used_size;
+
+  // Dense renaming of variables in first-occurrence order ('--compact').
+  // As the header can only be written after the last clause was parsed, the
+  // body is spooled, which keeps memory usage bounded by the number of
+  // declared variables.
+
+  int *map, mapped;
+
+  // Repairing the header ('--fix-header') accepts literals exceeding the
+  // declared number of variables and a different number of clauses.  Then
+  // arrays indexed by variables have to grow on-the-fly.
+
+  size_t variables_capacity;
+
+  struct block *blocks;
+  size_t size_blocks, capacity_blocks;
+  size_t header_bytes;
+
+  // Clauses are collected in a reusable buffer before they are written,
+  // which allows to canonicalize them by sorting literals
+  // ('--sort-literals'), removing duplicated literals and tautological
+  // clauses.
+
+  int *clause;
+  size_t clause_size, clause_capacity;
+  unsigned *keys, *tmp_keys;
+  size_t keys_capacity;
+  int emitted;
+
+  // Library owned arrays of clause batches ('normalizer_next_batch').
+
+  int *batch_literals;
+  size_t *batch_ends;
+  size_t batch_capacity;
+
+  // Sorting clauses ('--sort-clauses') collects clauses in a flat array of
+  // '<size> <literal> ...' records.  If it exceeds the memory limit, the
+  // clauses are sorted and written as binary run to a temporary file.  In
+  // the end all runs are merged (external merge sort).
+
+  struct arena sorted;
+  const int **starts;
+  size_t starts_size, starts_capacity;
+  FILE **runs, *pending_run;
+  size_t size_runs;
+  struct merger *mergers;
+  size_t *heap;
+
+  // Removing duplicated clauses ('--dedup') stores canonical clauses as
+  // records in an arena and uses an open-addressing hash table of
+  // pointers to these records.  If clauses are sorted anyway
+  // duplicates are adjacent and removed while writing sorted clauses
+  // instead.
+
+  struct arena hashed;
+  const int **table;
+  size_t table_size, table_capacity;
+  int sequence;
+  unsigned dedup_level;
+  bool dedup_spilling;
+  FILE *partitions[MAX_LEVELS][PARTITIONS];
+  struct merger partition_merger;
+  int *previous;
+  size_t previous_capacity;
+
+  // The fingerprint ('--fingerprint', or with '--hash' computed besides
+  // writing the output for the statistics) is a commutative sum of clause
+  // hashes, which in turn are commutative sums of literal hashes.  To make
+  // it also invariant under variable renaming ('--fingerprint=<rounds>')
+  // variables are colored by iterated color refinement over their clause
+  // neighborhood, which requires one pass per round over clauses spooled to
+  // a binary file.
+
+  uint64_t fingerprint_sum, hash;
+  FILE *fingerprint_spool;
+  uint64_t *color, *next_color;
+  struct merger fingerprint_merger;
+
+  // Sampling ('--sample') selects parsed clauses before they are imported
+  // (renamed and counted for features) and canonicalized.  A fraction keeps
+  // each clause independently with that probability (Bernoulli sampling).
+  // A count keeps a uniform random subset of that many clauses (reservoir
+  // sampling), which is stored as records and imported in the original
+  // order after parsing.  Replaced records are garbage, which is collected
+  // by copying the reservoir to the spare arena as soon as it exceeds the
+  // live records.  If the records exceed the memory limit they are all
+  // written to a temporary file (replaced ones remain there as garbage)
+  // and read back at their offset while importing.
+
+  uint64_t random, sample_threshold;
+  struct sample *reservoir;
+  size_t reservoir_size, reservoir_capacity;
+  struct arena samples, spare_samples;
+  size_t samples_live;
+  int sample_sequence;
+  size_t sampled;
+  FILE *sample_spool;
+  off_t sample_spool_bytes;
+  struct merger sample_merger;
+
+  FILE *csr_offsets;
+  uint64_t csr_literals;
+
+  struct shard *shards;
+  int total_emitted;
+  size_t spills, written;
+  char *shard_path;
+  FILE *shard_file;
+  int shard_mode;
+  pid_t shard_pid;
+
+  // We read the input in chunks into our own buffer, which avoids the
+  // locking overhead of 'getc' and gives us precise byte offsets.
+
+  unsigned char buffer[1 << 16];
+  size_t buffer_begin, buffer_end, buffer_size;
+  size_t bytes_before_buffer;
+};
+
+static size_t bytes_read(struct normalizer *n) {
+  return n->bytes_before_buffer + n->buffer_begin;
+}
+
+static void vdie(struct normalizer *n, int status, const char *fmt,
+                 va_list ap) {
+  vsnprintf(n->error, sizeof n->error, fmt, ap);
+  PROBE2(error, bytes_read(n), n->error);
+  n->status = status;
+  longjmp(n->jump, 1);
+}
+
+#define DIE(NAME, STATUS) \
+  static void NAME(struct normalizer *n, const char *fmt, ...) { \
+    va_list ap; \
+    va_start(ap, fmt); \
+    vdie(n, STATUS, fmt, ap); \
+  }
+
+DIE(parse_error, NORMALIZER_PARSE_ERROR)
+DIE(io_error, NORMALIZER_IO_ERROR)
+DIE(memory_error, NORMALIZER_MEMORY_ERROR)
+DIE(usage_error, NORMALIZER_USAGE_ERROR)
+
+static bool fill_buffer(struct normalizer *n) {
+  n->bytes_before_buffer += n->buffer_size;
+  n->buffer_begin = n->buffer_end = n->buffer_size = 0;
+  size_t bytes = fread(n->buffer, 1, sizeof n->buffer, n->input_file);
+  if (!bytes)
+    return false;
+  n->buffer_end = n->buffer_size = bytes;
+  PROBE2(chunk, n->bytes_before_buffer, bytes);
+  return true;
+}
+
+static inline int next(struct normalizer *n) {
+  if (n->buffer_begin == n->buffer_end && !fill_buffer(n))
+    return EOF;
+  return n->buffer[n->buffer_begin++];
+}
+
+static inline void unread_char(struct normalizer *n, int ch) {
+  if (ch != EOF)
+    n->buffer_begin--;
+}
+
+static bool has_suffix(const char *a, const char *b) {
+  size_t k = strlen(a), l = strlen(b);
+  return k >= l && !strcmp(a + k - l, b);
+}
+
+static bool exists_file(const char *path) {
+  struct stat buf;
+  return !stat(path, &buf);
+}
+
+static const char *has_prefix(const char *str, const char *prefix) {
+  size_t l = strlen(prefix);
+  return strncmp(str, prefix, l) ? 0 : str + l;
+}
+
+static void *allocate_zeroed(struct normalizer *n, size_t elements,
+                             size_t bytes) {
+  void *res = calloc(elements, bytes);
+  if (elements && !res)
+    memory_error(n, "out-of-memory allocating %zu times %zu bytes",
+                 elements, bytes);
+  return res;
+}
+
+static void *reallocate(struct normalizer *n, void *ptr, size_t elements,
+                        size_t bytes, const char *what) {
+  void *res = realloc(ptr, elements * bytes);
+  if (!res)
+    memory_error(n, "out-of-memory reallocating %s", what);
+  return res;
+}
+
+static void *reallocate_zeroed(struct normalizer *n, void *ptr,
+                               size_t old_elements, size_t new_elements,
+                               size_t bytes) {
+  char *res = realloc(ptr, new_elements * bytes);
+  if (!res)
+    memory_error(n, "out-of-memory reallocating %zu times %zu bytes",
+                 new_elements, bytes);
+  memset(res + old_elements * bytes, 0,
+         (new_elements - old_elements) * bytes);
+  return res;
+}
+
+static char *copy_string(struct normalizer *n, const char *str) {
+  char *res = malloc(strlen(str) + 1);
+  if (!res)
+    memory_error(n, "out-of-memory copying string");
+  return strcpy(res, str);
+}
+
+static const char *output_name(struct normalizer *n) {
+  return n->output_path ? n->output_path : "<stdout>";
+}
+
+static FILE *open_auxiliary(struct normalizer *n, const char *path,
+                            const char *what) {
+  FILE *file;
+  if (!strcmp(path, "-"))
+    file = stdout;
+  else if (!(file = fopen(path, "w")))
+    io_error(n, "can not write %s file '%s'", what, path);
+  return file;
+}
+
+static void close_auxiliary(FILE *file) {
+  if (file != stdout)
+    fclose(file);
+  else
+    fflush(file);
+}
+
+static void occurs(struct normalizer *n, int idx, bool negative) {
+  if (n->occurrences) {
+    unsigned *counter = &n->occurrences[idx][negative];
+    if (*counter != UINT_MAX)
+      *counter += 1;
+  } else
+    n->used[idx / 8] |= 1u << (idx & 7);
+}
+
+static bool is_used(struct normalizer *n, int idx) {
+  if (n->occurrences)
+    return n->occurrences[idx][0] || n->occurrences[idx][1];
+  return n->used[idx / 8] & (1u << (idx & 7));
+}
+
+static int unused_variables(struct normalizer *n, int variables) {
+  int res = 0;
+  for (int idx = 1; idx <= variables; idx++)
+    if (!is_used(n, idx))
+      res++;
+  return res;
+}
+
+static void write_occurrences(struct normalizer *n, int variables) {
+  FILE *file = open_auxiliary(n, n->opts.occurrences_path, "occurrences");
+  fprintf(file, "c variables %d\n", variables);
+  fprintf(file, "c max-variable %d\n", n->max_variable);
+  fprintf(file, "c unused-variables %d\n", unused_variables(n, variables));
+  fputs("c <variable> <positive> <negative>\n", file);
+  for (int idx = 1; idx <= variables; idx++)
+    fprintf(file, "%d %u %u\n", idx, n->occurrences[idx][0],
+            n->occurrences[idx][1]);
+  close_auxiliary(file);
+}
+
+static void increase_variables(struct normalizer *n, int idx) {
+  size_t old_capacity = n->variables_capacity;
+  if ((size_t) idx < old_capacity)
+    return;
+  size_t new_capacity = 2 * old_capacity;
+  if (new_capacity <= (size_t) idx)
+    new_capacity = idx + 1ul;
+  if (n->map)
+    n->map = reallocate_zeroed(n, n->map, old_capacity, new_capacity,
+                               sizeof *n->map);
+  if (n->occurrences)
+    n->occurrences = reallocate_zeroed(n, n->occurrences, old_capacity,
+                                       new_capacity, sizeof *n->occurrences);
+  if (n->used) {
+    size_t new_size = new_capacity / 8 + 1;
+    n->used = reallocate_zeroed(n, n->used, n->used_size, new_size, 1);
+    n->used_size = new_size;
+  }
+  n->variables_capacity = new_capacity;
+}
+
+static int rename_variable(struct normalizer *n, int idx) {
+  int res = n->map[idx];
+  if (!res)
+    n->map[idx] = res = ++n->mapped;
+  return res;
+}
+
+static void write_map(struct normalizer *n, int variables) {
+  FILE *file = open_auxiliary(n, n->opts.map_path, "map");
+  int *original = allocate_zeroed(n, n->mapped + 1ul, sizeof *original);
+  for (int idx = 1; idx <= variables; idx++)
+    if (n->map[idx])
+      original[n->map[idx]] = idx;
+  for (int idx = 1; idx <= n->mapped; idx++)
+    fprintf(file, "%d %d\n", idx, original[idx]);
+  free(original);
+  close_auxiliary(file);
+}
+
+// Literals are ordered by variable index first and then positive before
+// negative, which is the order of the following unsigned sort key.
+
+static inline unsigned literal_key(int lit) {
+  return lit < 0 ? 2u * (unsigned) -lit + 1 : 2u * (unsigned) lit;
+}
+
+static inline int key_literal(unsigned key) {
+  int idx = key / 2;
+  return (key & 1) ? -idx : idx;
+}
+
+#define COMPARE_SWAP(I, J) \
+  do { \
+    unsigned A = keys[I], B = keys[J]; \
+    if (A > B) \
+      keys[I] = B, keys[J] = A; \
+  } while (0)
+
+static void sort_keys(struct normalizer *n, size_t size) {
+  unsigned *keys = n->keys;
+  if (size == 2) {
+    COMPARE_SWAP(0, 1);
+  } else if (size == 3) {
+    COMPARE_SWAP(0, 1);
+    COMPARE_SWAP(1, 2);
+    COMPARE_SWAP(0, 1);
+  } else if (size == 4) {
+    COMPARE_SWAP(0, 1);
+    COMPARE_SWAP(2, 3);
+    COMPARE_SWAP(0, 2);
+    COMPARE_SWAP(1, 3);
+    COMPARE_SWAP(1, 2);
+  } else if (size <= 32) {
+    for (size_t i = 1; i < size; i++) {
+      unsigned key = keys[i];
+      size_t j = i;
+      while (j && keys[j - 1] > key)
+        keys[j] = keys[j - 1], j--;
+      keys[j] = key;
+    }
+  } else {
+    unsigned *a = keys, *b = n->tmp_keys;
+    for (unsigned shift = 0; shift != 32; shift += 8) {
+      size_t count[256] = {0};
+      for (size_t i = 0; i != size; i++)
+        count[(a[i] >> shift) & 255]++;
+      if (count[(a[0] >> shift) & 255] == size)
+        continue;
+      size_t pos = 0;
+      for (unsigned digit = 0; digit != 256; digit++) {
+        size_t tmp = count[digit];
+        count[digit] = pos;
+        pos += tmp;
+      }
+      for (size_t i = 0; i != size; i++)
+        b[count[(a[i] >> shift) & 255]++] = a[i];
+      unsigned *tmp = a;
+      a = b, b = tmp;
+    }
+    if (a != keys)
+      memcpy(keys, a, size * sizeof *keys);
+  }
+}
+
+// Returns 'false' if the clause is a tautology and should be removed.
+
+static bool canonicalize_clause(struct normalizer *n) {
+  size_t size = n->clause_size;
+  if (size > n->keys_capacity) {
+    n->keys_capacity = n->clause_capacity;
+    free(n->keys), free(n->tmp_keys);
+    n->keys = malloc(n->keys_capacity * sizeof *n->keys);
+    n->tmp_keys = malloc(n->keys_capacity * sizeof *n->tmp_keys);
+    if (!n->keys || !n->tmp_keys)
+      memory_error(n, "out-of-memory allocating sort keys");
+  }
+  unsigned *keys = n->keys;
+  for (size_t i = 0; i != size; i++)
+    keys[i] = literal_key(n->clause[i]);
+  sort_keys(n, size);
+  size_t j = 0;
+  for (size_t i = 0; i != size; i++) {
+    unsigned key = keys[i];
+    if (j && keys[j - 1] == key)
+      continue;
+    if (n->opts.remove_tautologies && j && keys[j - 1] == (key ^ 1))
+      return false;
+    keys[j++] = key;
+  }
+  for (size_t i = 0; i != j; i++)
+    n->clause[i] = key_literal(keys[i]);
+  n->clause_size = j;
+  return true;
+}
+
+static FILE *open_temporary(struct normalizer *n) {
+  const char *dir = n->opts.temp_dir;
+  if (!dir && !(dir = getenv("TMPDIR")))
+    dir = "/tmp";
+  size_t len = strlen(dir) + 32;
+  char *path = malloc(len);
+  if (!path)
+    memory_error(n, "out-of-memory allocating temporary path");
+  snprintf(path, len, "%s/normalize-cnf-XXXXXX", dir);
+  int fd = mkstemp(path);
+  if (fd >= 0)
+    unlink(path);
+  free(path);
+  if (fd < 0)
+    io_error(n, "can not create temporary file in '%s'", dir);
+  FILE *file = fdopen(fd, "w+");
+  if (!file) {
+    close(fd);
+    io_error(n, "can not open temporary file");
+  }
+  return file;
+}
+
+// The body is spooled in memory until it does not fit into the memory
+// limit anymore (next to the clauses kept for sorting and deduplication)
+// and then moved to a temporary file.  Copying it back uses 'sendfile' if
+// possible.  Note that the buffer of the memory stream is only valid after
+// flushing.
+
+static FILE *open_spool(struct normalizer *n) {
+  FILE *file = open_memstream(&n->spool_buffer, &n->spool_buffer_size);
+  if (!file)
+    io_error(n, "can not open memory spool");
+  n->memory_spool = true;
+  return file;
+}
+
+static void spill_spool(struct normalizer *n) {
+  if (fflush(n->body_file))
+    io_error(n, "flushing memory spool failed");
+  FILE *file = open_temporary(n);
+  if (fwrite(n->spool_buffer, 1, n->spool_buffer_size, file) !=
+      n->spool_buffer_size) {
+    fclose(file);
+    io_error(n, "writing spool file failed");
+  }
+  fclose(n->body_file);
+  free(n->spool_buffer);
+  n->spool_buffer = 0;
+  n->memory_spool = false;
+  n->body_file = file;
+  n->spills++;
+}
+
+// Memory used for clauses kept for sorting and deduplication, which shares
+// the memory limit with the memory spool.  Arenas keep their chunks when
+// reset, so all allocated chunks count.  The spool is charged twice its
+// size since growing the buffer of the memory stream copies it.
+
+static size_t kept_bytes(struct normalizer *n) {
+  size_t res = 0;
+  if (n->opts.sort_clauses)
+    res += n->sorted.allocated + n->starts_capacity * sizeof *n->starts;
+  if (n->opts.dedup)
+    res += n->hashed.allocated + n->table_capacity * sizeof *n->table;
+  if (n->opts.sample_count)
+    res += n->samples.allocated + n->spare_samples.allocated +
+           n->reservoir_capacity * sizeof *n->reservoir;
+  return res;
+}
+
+static void limit_spool(struct normalizer *n) {
+  if (n->memory_spool &&
+      2 * n->body_bytes + kept_bytes(n) > n->opts.memory_limit)
+    spill_spool(n);
+}
+
+static bool send_spool(struct normalizer *n, FILE *spool, FILE *file) {
+#ifdef __linux__
+  if (fflush(spool) || fflush(file))
+    return false;
+  off_t offset = 0, end = ftello(spool);
+  while (offset < end) {
+    ssize_t bytes =
+        sendfile(fileno(file), fileno(spool), &offset, end - offset);
+    if (bytes > 0)
+      continue;
+    if (!offset)
+      return false;
+    io_error(n, "sending spooled body to '%s' failed", output_name(n));
+  }
+  return true;
+#else
+  (void) n, (void) spool, (void) file;
+  return false;
+#endif
+}
+
+// Copies the spool to the file and closes it (the spool pointer is reset
+// before, since it might still be closed after an error).
+
+static void copy_spool(struct normalizer *n, FILE **spool_ptr, FILE *file) {
+  FILE *spool = *spool_ptr;
+  const char *path = output_name(n);
+  if (n->memory_spool && spool == n->body_file) {
+    fclose(spool);
+    *spool_ptr = 0;
+    n->memory_spool = false;
+    if (fwrite(n->spool_buffer, 1, n->spool_buffer_size, file) !=
+        n->spool_buffer_size)
+      io_error(n, "writing spooled body to '%s' failed", path);
+    free(n->spool_buffer);
+    n->spool_buffer = 0;
+    return;
+  }
+  if (!send_spool(n, spool, file)) {
+    char chunk[1 << 16];
+    size_t bytes;
+    rewind(spool);
+    while ((bytes = fread(chunk, 1, sizeof chunk, spool)))
+      if (fwrite(chunk, 1, bytes, file) != bytes)
+        io_error(n, "writing spooled body to '%s' failed", path);
+    if (ferror(spool))
+      io_error(n, "reading spool file failed");
+  }
+  fclose(spool);
+  *spool_ptr = 0;
+}
+
+static inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+static inline uint64_t hash_size(size_t size) {
+  return mix64(size + 0x9e3779b97f4a7c15ull);
+}
+
+static void fingerprint_clause(struct normalizer *n, const int *lits,
+                               size_t size) {
+  if (n->fingerprint_spool) {
+    int tmp = size;
+    if (fwrite(&tmp, sizeof tmp, 1, n->fingerprint_spool) != 1 ||
+        fwrite(lits, sizeof *lits, size, n->fingerprint_spool) != size)
+      io_error(n, "writing fingerprint spool failed");
+  } else {
+    uint64_t hash = hash_size(size);
+    for (size_t i = 0; i != size; i++)
+      hash += mix64(literal_key(lits[i]));
+    n->fingerprint_sum += mix64(hash);
+  }
+}
+
+static unsigned hash_clause(const int *lits, size_t size) {
+  uint64_t res = size;
+  for (size_t i = 0; i != size; i++)
+    res = (res + literal_key(lits[i])) * 0x9e3779b97f4a7c15ull;
+  return res >> 32;
+}
+
+// Besides DIMACS we support a compact binary format, which starts with the
+// magic string "BCNF" followed by the number of variables and clauses and
+// then the literals of clauses each terminated by zero.  All numbers are
+// encoded as variable-length unsigned integers with 7 bits per byte (least
+// significant first, highest bit set if more bytes follow).  A literal is
+// encoded as '2 * <variable> + <negative>' (as in binary DRAT proofs).
+
+#define BINARY_MAGIC "BCNF"
+
+static size_t write_varint(FILE *file, unsigned u) {
+  size_t bytes = 1;
+  while (u > 127) {
+    putc((u & 127) | 128, file);
+    u >>= 7;
+    bytes++;
+  }
+  putc(u, file);
+  return bytes;
+}
+
+// The delta format ('--delta') has the same header except for the magic
+// string "DCNF".  Clauses are given by their size followed by the literals
+// sorted by variable, each encoded as '2 * <delta> + <negative>' where
+// '<delta>' is the difference to the previous variable in the clause (for
+// the first literal its variable).  Codes are packed in groups of four with
+// group varint encoding: a tag byte with two bits per code giving its number
+// of bytes minus one, followed by the codes in little-endian byte order.
+// The last group of a clause may contain less than four codes.  This format
+// is more compact than the binary format and can be decoded without
+// branching on every byte (for instance with a shuffle table).
+
+#define DELTA_MAGIC "DCNF"
+
+static unsigned group_varint_bytes(unsigned u) {
+  return u < (1u << 8) ? 1 : u < (1u << 16) ? 2 : u < (1u << 24) ? 3 : 4;
+}
+
+static size_t write_delta_clause(FILE *file, const int *lits, size_t size) {
+  size_t bytes = write_varint(file, size);
+  unsigned codes[4], previous = 0;
+  for (size_t i = 0; i < size; i += 4) {
+    size_t group = size - i < 4 ? size - i : 4;
+    unsigned tag = 0;
+    for (size_t j = 0; j != group; j++) {
+      int lit = lits[i + j];
+      unsigned idx = abs(lit);
+      codes[j] = 2 * (idx - previous) + (lit < 0);
+      previous = idx;
+      tag |= (group_varint_bytes(codes[j]) - 1) << (2 * j);
+    }
+    putc(tag, file);
+    bytes++;
+    for (size_t j = 0; j != group; j++) {
+      unsigned length = group_varint_bytes(codes[j]);
+      for (unsigned k = 0; k != length; k++)
+        putc((codes[j] >> (8 * k)) & 255, file);
+      bytes += length;
+    }
+  }
+  return bytes;
+}
+
+static size_t write_header(struct normalizer *n, FILE *file, int variables,
+                           int clauses) {
+  if (!n->opts.binary_output && !n->opts.delta_output)
+    return fprintf(file, "p cnf %d %d\n", variables, clauses);
+  const char *magic = n->opts.delta_output ? DELTA_MAGIC : BINARY_MAGIC;
+  fputs(magic, file);
+  size_t bytes = strlen(magic);
+  bytes += write_varint(file, variables);
+  bytes += write_varint(file, clauses);
+  return bytes;
+}
+
+// The memory-mappable clause database ('--csr') is written in compressed
+// sparse row format, i.e., as the following header followed by a single
+// array of all literals (as 32-bit signed integers) and then the array of
+// 64-bit clause start positions in the literal array, which has one more
+// entry for the end of the last clause.  Both arrays start at a multiple of
+// 64 bytes and are written in native byte order.  Since the number of
+// clauses might change while writing, the offsets are spooled and appended
+// at the end and the header written last (thus requires a seekable file).
+
+struct csr_header {
+  char magic[8];               // "NCNFCSR1"
+  uint64_t variables, clauses; // as in a DIMACS header
+  uint64_t literals;           // size of literal array
+  uint64_t literals_offset;    // byte position of literal array
+  uint64_t offsets_offset;     // byte position of clause offsets array
+};
+
+#define CSR_ALIGNMENT 64
+
+static void write_zeros(FILE *file, size_t bytes) {
+  while (bytes--)
+    putc(0, file);
+}
+
+static void start_csr(struct normalizer *n) {
+  if (fseeko(n->output_file, 0, SEEK_SET))
+    io_error(n, "CSR output '%s' has to be a seekable file", output_name(n));
+  write_zeros(n->output_file, CSR_ALIGNMENT);
+  n->header_bytes = CSR_ALIGNMENT;
+  n->csr_offsets = open_temporary(n);
+}
+
+static void finish_csr(struct normalizer *n, int variables) {
+  uint64_t end = n->header_bytes + n->body_bytes;
+  size_t padding = (CSR_ALIGNMENT - end % CSR_ALIGNMENT) % CSR_ALIGNMENT;
+  write_zeros(n->output_file, padding);
+  if (fwrite(&n->csr_literals, sizeof n->csr_literals, 1, n->csr_offsets) !=
+      1)
+    io_error(n, "writing CSR offsets failed");
+  copy_spool(n, &n->csr_offsets, n->output_file);
+  struct csr_header header;
+  memset(&header, 0, sizeof header);
+  memcpy(header.magic, "NCNFCSR1", 8);
+  header.variables = variables;
+  header.clauses = n->emitted;
+  header.literals = n->csr_literals;
+  header.literals_offset = CSR_ALIGNMENT;
+  header.offsets_offset = end + padding;
+  n->written = header.offsets_offset +
+               (n->emitted + 1ul) * sizeof n->csr_literals;
+  if (fflush(n->output_file) || fseeko(n->output_file, 0, SEEK_SET) ||
+      fwrite(&header, sizeof header, 1, n->output_file) != 1 ||
+      fflush(n->output_file))
+    io_error(n, "writing CSR header to '%s' failed", output_name(n));
+}
+
+static void index_clause(struct normalizer *n, size_t size) {
+  if ((n->emitted - 1) % n->opts.index_block == 0) {
+    if (n->size_blocks == n->capacity_blocks) {
+      n->capacity_blocks = n->capacity_blocks ? 2 * n->capacity_blocks : 64;
+      n->blocks = reallocate(n, n->blocks, n->capacity_blocks,
+                             sizeof *n->blocks, "index blocks");
+    }
+    struct block *b = n->blocks + n->size_blocks++;
+    b->offset = n->body_bytes;
+    b->clauses = b->literals = 0;
+  }
+  struct block *b = n->blocks + n->size_blocks - 1;
+  b->clauses++;
+  b->literals += size;
+}
+
+static void write_uint64(FILE *file, uint64_t u) {
+  unsigned char bytes[8];
+  for (int i = 0; i != 8; i++)
+    bytes[i] = u >> (8 * i);
+  fwrite(bytes, 1, sizeof bytes, file);
+}
+
+static void write_index(struct normalizer *n) {
+  const char *path = n->opts.index_path;
+  FILE *file = fopen(path, "w");
+  if (!file)
+    io_error(n, "can not write index file '%s'", path);
+  fputs("NCNFIDX1", file);
+  write_uint64(file, n->opts.index_block);
+  write_uint64(file, n->emitted);
+  write_uint64(file, n->size_blocks);
+  for (size_t i = 0; i != n->size_blocks; i++) {
+    write_uint64(file, n->header_bytes + n->blocks[i].offset);
+    write_uint64(file, n->blocks[i].clauses);
+    write_uint64(file, n->blocks[i].literals);
+  }
+  if (fclose(file))
+    io_error(n, "writing index file '%s' failed", path);
+}
+
+static void write_clause(struct normalizer *n, const int *lits,
+                         size_t size) {
+  n->emitted++;
+  if (n->opts.fingerprint || n->opts.hash) {
+    fingerprint_clause(n, lits, size);
+    if (n->opts.fingerprint)
+      return;
+  }
+  FILE *file = n->body_file;
+  if (n->opts.gbd && n->emitted > 1)
+    fputc(' ', file), n->body_bytes++;
+  if (n->opts.index_path)
+    index_clause(n, size);
+  if (n->opts.csr) {
+    if (fwrite(&n->csr_literals, sizeof n->csr_literals, 1,
+               n->csr_offsets) != 1 ||
+        fwrite(lits, sizeof *lits, size, file) != size)
+      io_error(n, "writing CSR clause failed");
+    n->csr_literals += size;
+    n->body_bytes += size * sizeof *lits;
+    return;
+  }
+  if (n->opts.binary_output || n->opts.delta_output) {
+    if (n->opts.delta_output)
+      n->body_bytes += write_delta_clause(file, lits, size);
+    else {
+      for (size_t i = 0; i != size; i++)
+        n->body_bytes += write_varint(file, literal_key(lits[i]));
+      putc(0, file);
+      n->body_bytes++;
+    }
+    limit_spool(n);
+    return;
+  }
+  for (size_t i = 0; i != size; i++)
+    n->body_bytes += fprintf(file, "%d ", lits[i]);
+  if (n->opts.gbd)
+    fputc('0', file), n->body_bytes++;
+  else
+    fputs("0\n", file), n->body_bytes += 2;
+  limit_spool(n);
+}
+
+static int compare_clauses(const int *a, const int *b) {
+  if (a[0] != b[0])
+    return a[0] < b[0] ? -1 : 1;
+  for (int i = 1; i <= a[0]; i++) {
+    unsigned k = literal_key(a[i]), l = literal_key(b[i]);
+    if (k != l)
+      return k < l ? -1 : 1;
+  }
+  return 0;
+}
+
+#define MIN_CHUNK ((size_t) 1 << 16)
+#define MAX_CHUNK ((size_t) 1 << 26)
+#define HUGE_PAGE ((size_t) 1 << 21)
+
+static struct chunk *new_chunk(struct normalizer *n, struct arena *a,
+                               size_t needed) {
+  size_t bytes = a->last ? 2 * (a->last->end - a->last->begin) * sizeof (int)
+                         : MIN_CHUNK;
+  if (bytes > MAX_CHUNK)
+    bytes = MAX_CHUNK;
+  if (bytes < needed)
+    bytes = needed;
+  if (a->limit && a->allocated + bytes > a->limit) {
+    if (a->allocated + needed <= a->limit)
+      bytes = a->limit - a->allocated;
+    else if (a->used)
+      return 0;
+  }
+  struct chunk *c = allocate_zeroed(n, 1, sizeof *c);
+  void *data = 0;
+  if (bytes >= HUGE_PAGE) {
+    bytes = (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+    data = mmap(0, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+      data = 0;
+    else {
+      c->mapped = true;
+#ifdef MADV_HUGEPAGE
+      madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+    }
+  }
+  if (!data && !(data = malloc(bytes))) {
+    free(c);
+    memory_error(n, "out-of-memory allocating arena chunk of %zu bytes",
+                 bytes);
+  }
+  c->begin = data;
+  c->end = c->begin + bytes / sizeof (int);
+  if (a->last)
+    a->last->next = c;
+  else
+    a->chunks = c;
+  a->last = c;
+  a->allocated += bytes;
+  return c;
+}
+
+// Returns a record with room for 'size' literals and zero if the limit is
+// reached.
+
+static int *allocate_record(struct normalizer *n, struct arena *a,
+                            size_t size) {
+  const size_t needed = size + 1;
+  if (!a->current || (size_t) (a->current->end - a->top) < needed) {
+    struct chunk *c = a->current ? a->current->next : a->chunks;
+    while (c && (size_t) (c->end - c->begin) < needed)
+      c = c->next;
+    if (!c && !(c = new_chunk(n, a, needed * sizeof (int))))
+      return 0;
+    a->current = c;
+    a->top = c->begin;
+  }
+  int *res = a->top;
+  a->top += needed;
+  a->used += needed * sizeof (int);
+  res[0] = size;
+  return res;
+}
+
+static void reset_arena(struct arena *a) {
+  a->current = 0;
+  a->top = 0;
+  a->used = 0;
+}
+
+static void release_arena(struct arena *a) {
+  for (struct chunk *c = a->chunks, *next; c; c = next) {
+    next = c->next;
+    if (c->mapped)
+      munmap(c->begin, (c->end - c->begin) * sizeof (int));
+    else
+      free(c->begin);
+    free(c);
+  }
+  memset(a, 0, sizeof *a);
+}
+
+static int compare_starts(const void *p, const void *q) {
+  return compare_clauses(*(const int *const *) p, *(const int *const *) q);
+}
+
+static void sort_starts(struct normalizer *n) {
+  qsort(n->starts, n->starts_size, sizeof *n->starts, compare_starts);
+}
+
+// Sorting the clause starts with 'qsort' needs a buffer of the same size.
+
+static size_t sorted_bytes(struct normalizer *n) {
+  return n->sorted.used + 2 * n->starts_size * sizeof *n->starts;
+}
+
+static void output_clause(struct normalizer *n, const int *lits,
+                          size_t size) {
+  unsigned shards = n->opts.size_shards;
+  if (!shards) {
+    write_clause(n, lits, size);
+    return;
+  }
+  unsigned i;
+  if (n->opts.shard_method == ROUND_ROBIN)
+    i = n->total_emitted % shards;
+  else if (n->opts.shard_method == RANGE)
+    i = n->clauses ? (uint64_t) n->total_emitted * shards / n->clauses : 0;
+  else
+    i = hash_clause(lits, size) % shards;
+  if (i >= shards)
+    i = shards - 1;
+  struct shard *shard = n->shards + i;
+  n->body_file = shard->file;
+  n->emitted = shard->emitted;
+  n->body_bytes = shard->body_bytes;
+  write_clause(n, lits, size);
+  shard->emitted = n->emitted;
+  shard->body_bytes = n->body_bytes;
+  n->total_emitted++;
+}
+
+static void write_sorted_clause(struct normalizer *n, const int *c) {
+  if (n->opts.dedup) {
+    if (n->previous && !compare_clauses(n->previous, c))
+      return;
+    if (c[0] + 1u > n->previous_capacity) {
+      n->previous_capacity = c[0] + 1u;
+      n->previous = reallocate(n, n->previous, n->previous_capacity,
+                               sizeof *n->previous, "previous clause");
+    }
+    memcpy(n->previous, c, (c[0] + 1u) * sizeof *c);
+  }
+  output_clause(n, c + 1, c[0]);
+}
+
+// Merging uses a binary heap of runs ordered by their current clause.  If
+// there are too many runs they are merged into a single run early (which
+// bounds the number of open files).
+
+#define MAX_RUNS 128
+
+static bool read_run(struct normalizer *n, struct merger *m) {
+  int size;
+  if (fread(&size, sizeof size, 1, m->run) != 1)
+    return false;
+  if (size + 1u > m->capacity) {
+    m->capacity = size + 1u;
+    m->clause = reallocate(n, m->clause, m->capacity, sizeof *m->clause,
+                           "merge buffer");
+  }
+  m->clause[0] = size;
+  if (fread(m->clause + 1, sizeof *m->clause, size, m->run) != (size_t) size)
+    io_error(n, "reading sorted run failed");
+  return true;
+}
+
+static void write_record(struct normalizer *n, FILE *run, const int *c) {
+  if (fwrite(c, sizeof *c, c[0] + 1, run) != c[0] + 1u)
+    io_error(n, "writing sorted run failed");
+}
+
+static bool read_sequenced(struct normalizer *n, struct merger *m) {
+  if (fread(&m->sequence, sizeof m->sequence, 1, m->run) != 1)
+    return false;
+  if (!read_run(n, m))
+    io_error(n, "reading spilled clauses failed");
+  return true;
+}
+
+static void write_sequenced(struct normalizer *n, FILE *file, int sequence,
+                            const int *lits, size_t size) {
+  int tmp = size;
+  if (fwrite(&sequence, sizeof sequence, 1, file) != 1 ||
+      fwrite(&tmp, sizeof tmp, 1, file) != 1 ||
+      fwrite(lits, sizeof *lits, size, file) != size)
+    io_error(n, "writing spilled clauses failed");
+}
+
+static bool merger_less(struct merger *m, size_t i, size_t j) {
+  return compare_clauses(m[i].clause, m[j].clause) < 0;
+}
+
+static bool sequence_less(struct merger *m, size_t i, size_t j) {
+  return m[i].sequence < m[j].sequence;
+}
+
+typedef bool (*merger_order)(struct merger *, size_t, size_t);
+
+static void sift_down(struct merger *m, merger_order less, size_t *heap,
+                      size_t size, size_t pos) {
+  for (;;) {
+    size_t child = 2 * pos + 1, min = pos;
+    if (child < size && less(m, heap[child], heap[min]))
+      min = child;
+    if (child + 1 < size && less(m, heap[child + 1], heap[min]))
+      min = child + 1;
+    if (min == pos)
+      return;
+    size_t tmp = heap[pos];
+    heap[pos] = heap[min], heap[min] = tmp;
+    pos = min;
+  }
+}
+
+static void release_mergers(struct normalizer *n) {
+  struct merger *m = n->mergers;
+  if (!m)
+    return;
+  for (size_t i = 0; i != n->size_runs; i++) {
+    if (m[i].run)
+      fclose(m[i].run);
+    free(m[i].clause);
+  }
+  free(n->heap);
+  free(m);
+  n->heap = 0;
+  n->mergers = 0;
+  n->size_runs = 0;
+}
+
+// Merge all runs and either write the result as another run or as clauses
+// if 'run' is zero.  The runs are owned by the mergers while merging.
+// Sequenced runs of spilled clauses are merged by sequence number instead.
+
+static void merge_runs(struct normalizer *n, FILE *run, bool sequenced) {
+  bool (*read)(struct normalizer *, struct merger *) =
+      sequenced ? read_sequenced : read_run;
+  merger_order less = sequenced ? sequence_less : merger_less;
+  size_t size_runs = n->size_runs, size = 0;
+  struct merger *m = n->mergers =
+      allocate_zeroed(n, size_runs, sizeof *m);
+  size_t *heap = n->heap = allocate_zeroed(n, size_runs, sizeof *heap);
+  for (size_t i = 0; i != size_runs; i++) {
+    m[i].run = n->runs[i];
+    n->runs[i] = 0;
+    if (read(n, m + i))
+      heap[size++] = i;
+  }
+  for (size_t pos = size / 2; pos--;)
+    sift_down(m, less, heap, size, pos);
+  while (size) {
+    struct merger *top = m + heap[0];
+    const int *c = top->clause;
+    if (run && sequenced)
+      write_sequenced(n, run, top->sequence, c + 1, c[0]);
+    else if (run)
+      write_record(n, run, c);
+    else if (sequenced)
+      output_clause(n, c + 1, c[0]);
+    else
+      write_sorted_clause(n, c);
+    if (!read(n, top))
+      heap[0] = heap[--size];
+    sift_down(m, less, heap, size, 0);
+  }
+  release_mergers(n);
+}
+
+static inline uint64_t literal_color(const uint64_t *color, int lit) {
+  return lit < 0 ? mix64(color[-lit] + 1) : mix64(color[lit]);
+}
+
+static uint64_t refine_fingerprint(struct normalizer *n, int variables) {
+  uint64_t *color = n->color =
+      allocate_zeroed(n, variables + 1ul, sizeof *color);
+  uint64_t *next = n->next_color =
+      allocate_zeroed(n, variables + 1ul, sizeof *next);
+  struct merger *m = &n->fingerprint_merger;
+  m->run = n->fingerprint_spool;
+  n->fingerprint_spool = 0;
+  if (fflush(m->run))
+    io_error(n, "flushing fingerprint spool failed");
+  const int rounds = n->opts.fingerprint_rounds;
+  for (int round = 0; round <= rounds; round++) {
+    rewind(m->run);
+    n->fingerprint_sum = 0;
+    while (read_run(n, m)) {
+      const int size = m->clause[0], *lits = m->clause + 1;
+      uint64_t hash = hash_size(size);
+      for (int i = 0; i != size; i++)
+        hash += literal_color(color, lits[i]);
+      n->fingerprint_sum += mix64(hash);
+      if (round == rounds)
+        continue;
+      for (int i = 0; i != size; i++) {
+        int lit = lits[i];
+        uint64_t other = hash - literal_color(color, lit);
+        next[abs(lit)] += mix64(other + (lit < 0));
+      }
+    }
+    for (int idx = 1; idx <= variables; idx++)
+      color[idx] = mix64(color[idx] + mix64(next[idx])), next[idx] = 0;
+  }
+  return n->fingerprint_sum;
+}
+
+static void add_run(struct normalizer *n, FILE *run) {
+  if (fflush(run)) {
+    fclose(run);
+    io_error(n, "flushing sorted run failed");
+  }
+  rewind(run);
+  FILE **runs = realloc(n->runs, (n->size_runs + 1) * sizeof *runs);
+  if (!runs) {
+    fclose(run);
+    memory_error(n, "out-of-memory reallocating runs");
+  }
+  n->runs = runs;
+  runs[n->size_runs++] = run;
+}
+
+static void merge_early(struct normalizer *n, bool sequenced) {
+  if (n->size_runs < MAX_RUNS)
+    return;
+  FILE *merged = n->pending_run = open_temporary(n);
+  merge_runs(n, merged, sequenced);
+  n->pending_run = 0;
+  add_run(n, merged);
+}
+
+static void flush_run(struct normalizer *n) {
+  sort_starts(n);
+  FILE *run = n->pending_run = open_temporary(n);
+  n->spills++;
+  for (size_t i = 0; i != n->starts_size; i++)
+    write_record(n, run, n->starts[i]);
+  n->pending_run = 0;
+  add_run(n, run);
+  reset_arena(&n->sorted);
+  n->starts_size = 0;
+  merge_early(n, false);
+}
+
+static void save_clause(struct normalizer *n) {
+  const size_t size = n->clause_size;
+  int *record = allocate_record(n, &n->sorted, size);
+  if (!record) {
+    flush_run(n);
+    record = allocate_record(n, &n->sorted, size);
+  }
+  memcpy(record + 1, n->clause, size * sizeof *n->clause);
+  if (n->starts_size == n->starts_capacity) {
+    n->starts_capacity = n->starts_capacity ? 2 * n->starts_capacity : 256;
+    n->starts = reallocate(n, n->starts, n->starts_capacity,
+                           sizeof *n->starts, "clause starts");
+  }
+  n->starts[n->starts_size++] = record;
+  if (sorted_bytes(n) > n->opts.memory_limit)
+    flush_run(n);
+}
+
+static bool equal_clause(const int *c, const int *lits, size_t size) {
+  return c[0] == (int) size && !memcmp(c + 1, lits, size * sizeof *lits);
+}
+
+static void enlarge_table(struct normalizer *n) {
+  size_t old_capacity = n->table_capacity;
+  size_t new_capacity = old_capacity ? 2 * old_capacity : 1024;
+  const int **new_table =
+      allocate_zeroed(n, new_capacity, sizeof *new_table);
+  for (size_t i = 0; i != old_capacity; i++) {
+    const int *c = n->table[i];
+    if (!c)
+      continue;
+    size_t pos = hash_clause(c + 1, c[0]) & (new_capacity - 1);
+    while (new_table[pos])
+      pos = (pos + 1) & (new_capacity - 1);
+    new_table[pos] = c;
+  }
+  free(n->table);
+  n->table = new_table;
+  n->table_capacity = new_capacity;
+}
+
+// Tries to find the clause in the hash table and otherwise saves it unless
+// this would exceed the memory limit (then the table is frozen and all
+// clauses not found in it have to be spilled).
+
+enum { DUPLICATED, INSERTED, SPILLED };
+
+static int dedup_clause(struct normalizer *n, const int *lits,
+                        size_t size) {
+  const size_t limit = n->opts.memory_limit;
+  const bool may_spill = n->dedup_level < MAX_LEVELS;
+  size_t table_bytes = n->table_capacity * sizeof *n->table;
+  if (!n->dedup_spilling && 2 * (n->table_size + 1) > n->table_capacity) {
+    if (n->table_capacity && may_spill &&
+        n->hashed.used + 3 * table_bytes > limit)
+      n->dedup_spilling = true;
+    else
+      enlarge_table(n), table_bytes *= 2;
+  }
+  size_t mask = n->table_capacity - 1;
+  size_t pos = hash_clause(lits, size) & mask;
+  const int *c;
+  while ((c = n->table[pos])) {
+    if (equal_clause(c, lits, size))
+      return DUPLICATED;
+    pos = (pos + 1) & mask;
+  }
+  if (n->dedup_spilling)
+    return SPILLED;
+  n->hashed.limit = !may_spill          ? 0
+                    : table_bytes < limit ? limit - table_bytes
+                                          : 1;
+  int *record = allocate_record(n, &n->hashed, size);
+  if (!record) {
+    n->dedup_spilling = true;
+    return SPILLED;
+  }
+  memcpy(record + 1, lits, size * sizeof *lits);
+  n->table[pos] = record;
+  n->table_size++;
+  return INSERTED;
+}
+
+static void spill_clause(struct normalizer *n, int sequence,
+                         const int *lits, size_t size) {
+  const unsigned level = n->dedup_level;
+  unsigned i = mix64(hash_clause(lits, size) + level) % PARTITIONS;
+  FILE **file = &n->partitions[level][i];
+  if (!*file) {
+    *file = open_temporary(n);
+    n->spills++;
+  }
+  write_sequenced(n, *file, sequence, lits, size);
+}
+
+static void dedup_partitions(struct normalizer *, unsigned level);
+
+// Deduplicates a partition with an empty hash table at the next level and
+// writes clauses seen first to a run of survivors.
+
+static void dedup_partition(struct normalizer *n, unsigned level,
+                            FILE *file) {
+  n->dedup_level = level;
+  n->dedup_spilling = false;
+  reset_arena(&n->hashed);
+  memset(n->table, 0, n->table_capacity * sizeof *n->table);
+  n->table_size = 0;
+  if (fflush(file))
+    io_error(n, "flushing spilled clauses failed");
+  rewind(file);
+  FILE *survivors = n->pending_run = open_temporary(n);
+  struct merger *m = &n->partition_merger;
+  m->run = file;
+  while (read_sequenced(n, m)) {
+    const int size = m->clause[0], *lits = m->clause + 1;
+    int res = dedup_clause(n, lits, size);
+    if (res == INSERTED)
+      write_sequenced(n, survivors, m->sequence, lits, size);
+    else if (res == SPILLED)
+      spill_clause(n, m->sequence, lits, size);
+  }
+  m->run = 0;
+  n->pending_run = 0;
+  add_run(n, survivors);
+  if (n->dedup_spilling)
+    dedup_partitions(n, level);
+}
+
+static void dedup_partitions(struct normalizer *n, unsigned level) {
+  for (unsigned i = 0; i != PARTITIONS; i++) {
+    FILE *file = n->partitions[level][i];
+    if (!file)
+      continue;
+    dedup_partition(n, level + 1, file);
+    n->partitions[level][i] = 0;
+    fclose(file);
+    merge_early(n, true);
+  }
+}
+
+static void dedup_parsed_clause(struct normalizer *n) {
+  const int sequence = n->sequence++;
+  const int *lits = n->clause;
+  const size_t size = n->clause_size;
+  int res = dedup_clause(n, lits, size);
+  if (res == INSERTED)
+    output_clause(n, lits, size);
+  else if (res == SPILLED)
+    spill_clause(n, sequence, lits, size);
+}
+
+// Clauses spilled while parsing come after all clauses written already.
+// They are deduplicated by partition and the survivors then merged in the
+// original order.
+
+static void write_spilled_clauses(struct normalizer *n) {
+  dedup_partitions(n, 0);
+  merge_runs(n, 0, true);
+}
+
+// Called for each canonical clause left in the clause buffer.
+
+static void store_clause(struct normalizer *n) {
+  if (n->opts.sort_clauses)
+    save_clause(n);
+  else if (n->opts.dedup)
+    dedup_parsed_clause(n);
+  else
+    output_clause(n, n->clause, n->clause_size);
+}
+
+static void write_sorted_clauses(struct normalizer *n) {
+  if (!n->size_runs) {
+    sort_starts(n);
+    for (size_t i = 0; i != n->starts_size; i++)
+      write_sorted_clause(n, n->starts[i]);
+  } else {
+    if (n->starts_size)
+      flush_run(n);
+    merge_runs(n, 0, false);
+  }
+  reset_arena(&n->sorted);
+  n->starts_size = 0;
+}
+
+static size_t parse_size(struct normalizer *n, const char *arg,
+                         const char *str) {
+  char *end;
+  unsigned long long res = strtoull(str, &end, 10);
+  if (end == str)
+  INVALID_SIZE:
+    usage_error(n, "invalid size in '%s'", arg);
+  unsigned shift = 0;
+  if (*end == 'k' || *end == 'K')
+    shift = 10, end++;
+  else if (*end == 'm' || *end == 'M')
+    shift = 20, end++;
+  else if (*end == 'g' || *end == 'G')
+    shift = 30, end++;
+  if (*end || (res << shift) >> shift != res || !res)
+    goto INVALID_SIZE;
+  return res << shift;
+}
+
+// Compressed output is written through a pipe to an 'xz' child process,
+// which is started directly (as the decompressor for input below) and not
+// through a shell, since the path might contain shell meta characters.  The
+// output file itself is opened by us and becomes the standard output of
+// the child.
+
+static FILE *open_compressor(const char *path, pid_t *pid_ptr) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0)
+    return 0;
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC)) {
+    close(fd);
+    return 0;
+  }
+  pid_t pid = fork();
+  if (!pid) {
+    dup2(fds[0], 0);
+    dup2(fd, 1);
+    execlp("xz", "xz", "-e", "-c", (char *) 0);
+    _exit(127);
+  }
+  close(fds[0]);
+  close(fd);
+  FILE *file = pid < 0 ? 0 : fdopen(fds[1], "w");
+  if (!file) {
+    close(fds[1]);
+    if (pid > 0)
+      waitpid(pid, 0, 0);
+    return 0;
+  }
+  *pid_ptr = pid;
+  return file;
+}
+
+static FILE *open_output(struct normalizer *n, const char *path, int *mode,
+                         pid_t *pid) {
+  FILE *file;
+  if (!path || !strcmp(path, "-")) {
+    file = stdout;
+    *mode = 0;
+  } else if (has_suffix(path, ".xz")) {
+    file = open_compressor(path, pid);
+    *mode = 2;
+  } else {
+    file = fopen(path, "w");
+    *mode = 1;
+  }
+  if (!file)
+    io_error(n, "can not write output file '%s'", path);
+  PROBE2(open, path ? path : "<stdout>", *mode);
+  return file;
+}
+
+// Returns 'false' if closing failed or the compressor did not succeed.
+
+static bool close_output(FILE *file, int mode, pid_t pid, const char *path) {
+  if (mode == 1)
+    return !fclose(file);
+  if (mode != 2)
+    return true;
+  bool res = !fclose(file);
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR) {
+      status = -1;
+      break;
+    }
+  PROBE2(close, path, status);
+  return res && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+static char *shard_path(struct normalizer *n, unsigned i) {
+  const char *path = n->output_path;
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  const char *dot = strchr(base, '.');
+  size_t prefix = dot ? (size_t) (dot - path) : strlen(path);
+  size_t len = strlen(path) + 16;
+  char *res = n->shard_path = reallocate(n, n->shard_path, len, 1,
+                                          "shard path");
+  snprintf(res, len, "%.*s-%u%s", (int) prefix, path, i, path + prefix);
+  return res;
+}
+
+static void start_shards(struct normalizer *n) {
+  n->shards = allocate_zeroed(n, n->opts.size_shards, sizeof *n->shards);
+  for (unsigned i = 0; i != n->opts.size_shards; i++)
+    n->shards[i].file = open_temporary(n);
+}
+
+static void finish_shards(struct normalizer *n, int variables) {
+  for (unsigned i = 0; i != n->opts.size_shards; i++) {
+    struct shard *shard = n->shards + i;
+    const char *path = shard_path(n, i);
+    FILE *file = n->shard_file =
+        open_output(n, path, &n->shard_mode, &n->shard_pid);
+    if (!n->opts.gbd)
+      n->written += write_header(n, file, variables, shard->emitted);
+    n->written += shard->body_bytes;
+    copy_spool(n, &shard->file, file);
+    n->shard_file = 0;
+    if (!close_output(file, n->shard_mode, n->shard_pid, path))
+      io_error(n, "writing shard '%s' failed", path);
+  }
+}
+
+static void add_to_histogram(struct normalizer *n, size_t size) {
+  if (size >= n->histogram_size) {
+    size_t old_size = n->histogram_size;
+    size_t new_size = old_size ? 2 * old_size : 16;
+    while (new_size <= size)
+      new_size *= 2;
+    n->histogram = reallocate_zeroed(n, n->histogram, old_size, new_size,
+                                     sizeof *n->histogram);
+    n->histogram_size = new_size;
+  }
+  n->histogram[size]++;
+  if (!size)
+    n->empty++;
+  else if (size == 2)
+    n->binary++;
+  else if (size == 3)
+    n->ternary++;
+}
+
+static void write_features(struct normalizer *n, int variables,
+                           int clauses) {
+  FILE *file = open_auxiliary(n, n->opts.features_path, "features");
+  size_t literals = n->literals, positive = n->positive;
+  fprintf(file, "{\n");
+  fprintf(file, "  \"variables\": %d,\n", variables);
+  fprintf(file, "  \"clauses\": %d,\n", clauses);
+  fprintf(file, "  \"max_variable\": %d,\n", n->max_variable);
+  fprintf(file, "  \"unused_variables\": %d,\n",
+          unused_variables(n, variables));
+  fprintf(file, "  \"literals\": %zu,\n", literals);
+  fprintf(file, "  \"positive_literals\": %zu,\n", positive);
+  fprintf(file, "  \"negative_literals\": %zu,\n", n->negative);
+  fprintf(file, "  \"positive_ratio\": %.6f,\n",
+          literals ? positive / (double) literals : 0);
+  fprintf(file, "  \"empty_clauses\": %zu,\n", n->empty);
+  fprintf(file, "  \"binary_clauses\": %zu,\n", n->binary);
+  fprintf(file, "  \"ternary_clauses\": %zu,\n", n->ternary);
+  fprintf(file, "  \"clause_size_histogram\": {");
+  const char *separator = "";
+  for (size_t size = 0; size != n->histogram_size; size++)
+    if (n->histogram[size]) {
+      fprintf(file, "%s\n    \"%zu\": %zu", separator, size,
+              n->histogram[size]);
+      separator = ",";
+    }
+  fprintf(file, "%s}\n}\n", *separator ? "\n  " : "");
+  close_auxiliary(file);
+}
+
+// The header and the body are either parsed in DIMACS format or in binary
+// format, which is detected by its magic string.  Each parsed clause is
+// collected in the clause buffer and then passed to 'import_clause'.
+
+static int parse_header_number(struct normalizer *n, int ch,
+                               const char *name) {
+  if (!isdigit(ch))
+  INVALID_NUMBER:
+    parse_error(n, "invalid number of %s", name);
+  int res = ch - '0';
+  while (isdigit(ch = next(n))) {
+    if (INT_MAX / 10 < res)
+      goto INVALID_NUMBER;
+    res *= 10;
+    int digit = ch - '0';
+    if (INT_MAX - digit < res)
+      goto INVALID_NUMBER;
+    res += digit;
+  }
+  unread_char(n, ch);
+  return res;
+}
+
+static unsigned read_varint(struct normalizer *n) {
+  unsigned res = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    int ch = next(n);
+    if (ch == EOF)
+      parse_error(n, "unexpected end-of-file in binary number");
+    if (shift == 28 && (ch & 0xf0))
+      parse_error(n, "binary number exceeds 32 bits");
+    res |= (unsigned) (ch & 127) << shift;
+    if (!(ch & 128))
+      return res;
+  }
+}
+
+static void parse_binary_header(struct normalizer *n, const char *magic) {
+  for (const char *p = magic + 1; *p; p++)
+    if (*p != next(n))
+      parse_error(n, "invalid binary header magic");
+  unsigned v = read_varint(n), c = read_varint(n);
+  if (v > INT_MAX)
+    parse_error(n, "invalid number of variables");
+  if (c > INT_MAX)
+    parse_error(n, "invalid number of clauses");
+  n->variables = v, n->clauses = c;
+  if (magic[0] == DELTA_MAGIC[0])
+    n->delta_input = true;
+  else
+    n->binary_input = true;
+}
+
+static void parse_header(struct normalizer *n) {
+  int ch;
+  for (;;) {
+    ch = next(n);
+    if (ch == 'c') {
+      while ((ch = next(n)) != '\n')
+        if (ch == EOF)
+          parse_error(n, "end-of-file in comment");
+    } else if (ch == ' ' || ch == '\t' || ch == '\r') {
+      while ((ch = next(n)) != '\n')
+        if (ch == EOF)
+          parse_error(n, "unexpected end-of-file after white-space");
+    } else if (ch != '\n')
+      break;
+  }
+  if (ch == BINARY_MAGIC[0] || ch == DELTA_MAGIC[0]) {
+    parse_binary_header(n,
+                        ch == DELTA_MAGIC[0] ? DELTA_MAGIC : BINARY_MAGIC);
+    return;
+  }
+  if (ch != 'p')
+    parse_error(n, "expected 'p cnf ...' header or 'c' comment");
+  for (const char *p = " cnf "; *p; p++)
+    if (*p != next(n))
+      parse_error(n, "invalid 'p cnf ...' header");
+  n->variables = parse_header_number(n, next(n), "variables");
+  if (next(n) != ' ')
+    parse_error(n, "expected space in header after variables");
+  n->clauses = parse_header_number(n, next(n), "clauses");
+  ch = next(n);
+  if (ch == '\r')
+    ch = next(n);
+  if (ch == ' ' || ch == '\t') {
+    while ((ch = next(n)) != '\n')
+      if (ch != ' ' && ch != '\t' && ch != '\r')
+      EXPECTED_NEW_LINE_AFTER_HEADER:
+        parse_error(n, "expected white-space and a new-line after clauses");
+  } else if (ch != '\n')
+    goto EXPECTED_NEW_LINE_AFTER_HEADER;
+}
+
+static void push_literal(struct normalizer *n, int lit) {
+  int idx = abs(lit);
+  if (idx > n->variables) {
+    if (!n->opts.fix_header)
+      parse_error(n, "invalid literal");
+    increase_variables(n, idx);
+    n->variables = idx;
+  }
+  if (n->clause_size == n->clause_capacity) {
+    n->clause_capacity = n->clause_capacity ? 2 * n->clause_capacity : 16;
+    n->clause = reallocate(n, n->clause, n->clause_capacity,
+                           sizeof *n->clause, "clause buffer");
+  }
+  n->clause[n->clause_size++] = lit;
+}
+
+static bool missing_clauses(struct normalizer *n) {
+  return n->parsed < n->clauses && !n->opts.fix_header;
+}
+
+static bool parse_binary_clause(struct normalizer *n) {
+  int ch;
+  while ((ch = next(n)) != EOF) {
+    unread_char(n, ch);
+    unsigned u = read_varint(n);
+    if (u == 1 || u / 2 > INT_MAX)
+      parse_error(n, "invalid binary literal");
+    int idx = u / 2;
+    if (!idx)
+      return true;
+    push_literal(n, (u & 1) ? -idx : idx);
+  }
+  if (n->clause_size)
+    parse_error(n, "zero at end of last clause missing");
+  if (missing_clauses(n))
+    parse_error(n, "clause missing");
+  return false;
+}
+
+static bool parse_delta_clause(struct normalizer *n) {
+  int ch = next(n);
+  if (ch == EOF) {
+    if (missing_clauses(n))
+      parse_error(n, "clause missing");
+    return false;
+  }
+  unread_char(n, ch);
+  unsigned size = read_varint(n), idx = 0;
+  if (size > INT_MAX)
+    parse_error(n, "invalid clause size");
+  for (unsigned i = 0; i < size; i += 4) {
+    int tag = next(n);
+    if (tag == EOF)
+      parse_error(n, "unexpected end-of-file in delta encoded clause");
+    unsigned group = size - i < 4 ? size - i : 4;
+    for (unsigned j = 0; j != group; j++, tag >>= 2) {
+      unsigned length = (tag & 3) + 1, code = 0;
+      for (unsigned k = 0; k != length; k++) {
+        if ((ch = next(n)) == EOF)
+          parse_error(n, "unexpected end-of-file in delta encoded clause");
+        code |= (unsigned) ch << (8 * k);
+      }
+      if (code / 2 > INT_MAX - idx)
+        parse_error(n, "invalid delta encoded literal");
+      idx += code / 2;
+      if (!idx)
+        parse_error(n, "invalid delta encoded literal");
+      push_literal(n, (code & 1) ? -(int) idx : (int) idx);
+    }
+  }
+  return true;
+}
+
+static bool parse_dimacs_clause(struct normalizer *n) {
+  int ch, lit;
+  for (;;) {
+    ch = next(n);
+    if (ch == EOF) {
+      if (n->clause_size)
+        parse_error(n, "zero at end of last clause missing");
+      if (missing_clauses(n))
+        parse_error(n, "clause missing");
+      return false;
+    }
+    if (ch == 'c') {
+      while ((ch = next(n)) != '\n')
+        if (ch == EOF) {
+          if (n->clause_size || missing_clauses(n))
+          END_OF_FILE_IN_COMMENT:
+            parse_error(n, "end-of-file in comment");
+          else
+            return false;
+        }
+      continue;
+    }
+    if (ch == '\r')
+      ch = next(n);
+    if (ch == ' ' || ch == '\n' || ch == '\t')
+      continue;
+    int sign = 1;
+    if (ch == '-') {
+      ch = next(n);
+      sign = -1;
+    }
+    if (!isdigit(ch))
+    INVALID_LITERAL:
+      parse_error(n, "invalid literal");
+    lit = ch - '0';
+    while (isdigit(ch = next(n))) {
+      if (INT_MAX / 10 < lit)
+        goto INVALID_LITERAL;
+      lit *= 10;
+      int digit = ch - '0';
+      if (INT_MAX - digit < lit)
+        goto INVALID_LITERAL;
+      lit += digit;
+    }
+    if (ch == '\r')
+      ch = next(n);
+    if (ch != ' ' && ch != '\n' && ch != '\t' && ch != 'c' && ch != EOF)
+      parse_error(n, "expected white-space after literal");
+    if (ch == 'c') {
+      while ((ch = next(n)) != '\n')
+        if (ch == EOF) {
+          if (lit || missing_clauses(n))
+            goto END_OF_FILE_IN_COMMENT;
+          else
+            break;
+        }
+    }
+    if (!lit)
+      return true;
+    push_literal(n, sign * lit);
+  }
+}
+
+// Gathers features and occurrences of the parsed clause and renames its
+// variables in place ('--compact').
+
+static void import_clause(struct normalizer *n) {
+  const bool features = n->opts.features_path || n->opts.occurrences_path;
+  const bool compact = n->opts.compact;
+  int *lits = n->clause;
+  const size_t size = n->clause_size;
+  for (size_t i = 0; i != size; i++) {
+    int lit = lits[i], idx = abs(lit);
+    if (features) {
+      if (lit > 0)
+        n->positive++;
+      else
+        n->negative++;
+      occurs(n, idx, lit < 0);
+    }
+    if (idx > n->max_variable)
+      n->max_variable = idx;
+    if (compact) {
+      int renamed = rename_variable(n, idx);
+      lits[i] = lit < 0 ? -renamed : renamed;
+    }
+  }
+  if (features) {
+    n->literals += size;
+    add_to_histogram(n, size);
+  }
+}
+
+// Compressed input is read from a pipe written by an 'xz' child process.
+// Instead of 'popen' we start it directly to know its process identifier,
+// so it can be killed if the input is closed before its end (for instance
+// after parsing only the header), instead of letting it decompress the
+// rest of the file, which would also happen if 'SIGPIPE' is ignored.
+
+static FILE *open_decompressor(const char *path, pid_t *pid_ptr) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC))
+    return 0;
+  pid_t pid = fork();
+  if (!pid) {
+    dup2(fds[1], 1);
+    execlp("xz", "xz", "-d", "-c", "--", path, (char *) 0);
+    _exit(127);
+  }
+  close(fds[1]);
+  FILE *file = pid < 0 ? 0 : fdopen(fds[0], "r");
+  if (!file) {
+    close(fds[0]);
+    if (pid > 0) {
+      kill(pid, SIGKILL);
+      waitpid(pid, 0, 0);
+    }
+    return 0;
+  }
+  *pid_ptr = pid;
+  return file;
+}
+
+static int wait_process(pid_t pid) {
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  return status;
+}
+
+static int close_decompressor(FILE *file, pid_t pid, bool terminate) {
+  if (terminate)
+    kill(pid, SIGTERM);
+  fclose(file);
+  return wait_process(pid);
+}
+
+static void close_input_decompressor(struct normalizer *n) {
+  if (n->input_pid) {
+    int status =
+        close_decompressor(n->input_file, n->input_pid, !n->body_parsed);
+    PROBE2(close, n->input_path, status);
+  } else
+    fclose(n->input_file);
+  n->input_pid = 0;
+}
+
+// After parsing the body until the end of a compressed input 'xz' has
+// closed the pipe and is reaped to check that decompression succeeded, as
+// a truncated file otherwise just looks shorter (which '--fix-header' and
+// sampling would accept).
+
+static void check_decompressor(struct normalizer *n) {
+  if (n->close_input != 2 || !n->input_pid || !feof(n->input_file))
+    return;
+  int status = wait_process(n->input_pid);
+  n->input_pid = 0;
+  PROBE2(close, n->input_path, status);
+  if (!WIFEXITED(status) || WEXITSTATUS(status))
+    io_error(n, "decompressing input file '%s' failed", n->input_path);
+}
+
+// Random numbers for sampling ('--sample') are generated by 'splitmix64'
+// starting at the seed ('--seed').
+
+static uint64_t next_random(struct normalizer *n) {
+  n->random += 0x9e3779b97f4a7c15ull;
+  return mix64(n->random);
+}
+
+static size_t random_below(struct normalizer *n, uint64_t bound) {
+  return ((unsigned __int128) next_random(n) * bound) >> 64;
+}
+
+static void start_sampling(struct normalizer *n) {
+  n->random = n->opts.seed;
+  const double scale = 18446744073709551616.0; // 2^64
+  double threshold = n->opts.sample_fraction * scale;
+  n->sample_threshold = threshold < scale ? threshold : UINT64_MAX;
+}
+
+static void compact_reservoir(struct normalizer *n) {
+  reset_arena(&n->spare_samples);
+  for (size_t i = 0; i != n->reservoir_size; i++) {
+    const int *old = n->reservoir[i].record;
+    if (!old)
+      continue;
+    int *record = allocate_record(n, &n->spare_samples, old[0]);
+    memcpy(record + 1, old + 1, old[0] * sizeof *old);
+    n->reservoir[i].record = record;
+  }
+  struct arena tmp = n->samples;
+  n->samples = n->spare_samples;
+  n->spare_samples = tmp;
+  reset_arena(&n->spare_samples);
+}
+
+static size_t record_bytes(const int *record) {
+  return (record[0] + 1u) * sizeof *record;
+}
+
+static void spill_reservoir(struct normalizer *n) {
+  if (!n->sample_spool) {
+    n->sample_spool = open_temporary(n);
+    n->spills++;
+  }
+  for (size_t i = 0; i != n->reservoir_size; i++) {
+    struct sample *s = n->reservoir + i;
+    const int *record = s->record;
+    if (!record)
+      continue;
+    write_sequenced(n, n->sample_spool, s->sequence, record + 1, record[0]);
+    s->record = 0;
+    s->offset = n->sample_spool_bytes;
+    n->sample_spool_bytes += record_bytes(record) + sizeof s->sequence;
+  }
+  reset_arena(&n->samples);
+  n->samples_live = 0;
+}
+
+static void reservoir_clause(struct normalizer *n) {
+  const int sequence = n->sample_sequence++;
+  size_t slot;
+  if (n->reservoir_size < n->opts.sample_count) {
+    if (n->reservoir_size == n->reservoir_capacity) {
+      size_t capacity = n->reservoir_capacity ? 2 * n->reservoir_capacity
+                                              : 256;
+      if (capacity > n->opts.sample_count)
+        capacity = n->opts.sample_count;
+      n->reservoir = reallocate(n, n->reservoir, capacity,
+                                sizeof *n->reservoir, "reservoir");
+      n->reservoir_capacity = capacity;
+    }
+    slot = n->reservoir_size++;
+  } else if ((slot = random_below(n, sequence + 1ull)) <
+             n->reservoir_size) {
+    if (n->reservoir[slot].record)
+      n->samples_live -= record_bytes(n->reservoir[slot].record);
+  } else
+    return;
+  int *record = allocate_record(n, &n->samples, n->clause_size);
+  memcpy(record + 1, n->clause, n->clause_size * sizeof *n->clause);
+  n->reservoir[slot].sequence = sequence;
+  n->reservoir[slot].record = record;
+  n->samples_live += record_bytes(record);
+  // Spilling scans the whole reservoir, so it waits until the records take
+  // at least as much memory as the reservoir itself.
+  const size_t reservoir_bytes = n->reservoir_size * sizeof *n->reservoir;
+  if (n->samples_live + reservoir_bytes > n->opts.memory_limit &&
+      n->samples_live >= reservoir_bytes)
+    spill_reservoir(n);
+  else if (n->samples.used > MIN_CHUNK &&
+           n->samples.used > 2 * n->samples_live)
+    compact_reservoir(n);
+}
+
+static int compare_samples(const void *p, const void *q) {
+  const struct sample *a = p, *b = q;
+  return (a->sequence > b->sequence) - (a->sequence < b->sequence);
+}
+
+static void sort_reservoir(struct normalizer *n) {
+  qsort(n->reservoir, n->reservoir_size, sizeof *n->reservoir,
+        compare_samples);
+}
+
+static bool next_sampled_clause(struct normalizer *n) {
+  if (n->sampled == n->reservoir_size)
+    return false;
+  const struct sample *s = n->reservoir + n->sampled++;
+  const int *record = s->record;
+  if (!record) {
+    struct merger *m = &n->sample_merger;
+    m->run = n->sample_spool;
+    if (fseeko(m->run, s->offset, SEEK_SET) || !read_sequenced(n, m))
+      io_error(n, "reading spilled clauses failed");
+    record = m->clause;
+  }
+  n->clause_size = record[0];
+  memcpy(n->clause, record + 1, n->clause_size * sizeof *n->clause);
+  return true;
+}
+
+static bool sample_clause(struct normalizer *n) {
+  if (n->opts.sample_count) {
+    reservoir_clause(n);
+    return false;
+  }
+  return !n->opts.sample_fraction || next_random(n) < n->sample_threshold;
+}
+
+// Parses the next clause and returns 'false' at the end of the input.  A
+// clause which did not fit into the last batch is returned first.  Clauses
+// of a reservoir sample are imported after the body has been parsed, so
+// that renaming and features only take sampled clauses into account.
+
+static bool next_clause(struct normalizer *n) {
+  if (n->pending_clause) {
+    n->pending_clause = false;
+    return true;
+  }
+  for (;;) {
+    if (n->body_parsed) {
+      if (!n->opts.sample_count || !next_sampled_clause(n))
+        return false;
+    } else {
+      n->clause_size = 0;
+      bool parsed;
+      if (n->binary_input)
+        parsed = parse_binary_clause(n);
+      else if (n->delta_input)
+        parsed = parse_delta_clause(n);
+      else
+        parsed = parse_dimacs_clause(n);
+      if (!parsed) {
+        n->body_parsed = true;
+        check_decompressor(n);
+        if (n->opts.sample_count)
+          sort_reservoir(n);
+        continue;
+      }
+      if (n->parsed++ == n->clauses && !n->opts.fix_header)
+        parse_error(n, "too many clauses");
+      if (!sample_clause(n))
+        continue;
+    }
+    import_clause(n);
+    if (!n->opts.sort_literals || canonicalize_clause(n))
+      return true;
+  }
+}
+
+// Library owned batches have room for this many clauses and literals
+// (unless a single clause needs more).
+
+#define BATCH_CLAUSES (1u << 12)
+#define BATCH_LITERALS (1u << 16)
+
+static size_t next_batch(struct normalizer *n, normalizer_batch *batch) {
+  const bool owned = !batch->literals_capacity;
+  size_t max_clauses, max_literals;
+  int *literals;
+  size_t *ends;
+  if (owned) {
+    if (!n->batch_ends) {
+      n->batch_ends =
+          allocate_zeroed(n, BATCH_CLAUSES, sizeof *n->batch_ends);
+      n->batch_literals =
+          allocate_zeroed(n, BATCH_LITERALS, sizeof *n->batch_literals);
+      n->batch_capacity = BATCH_LITERALS;
+    }
+    max_clauses = BATCH_CLAUSES;
+    max_literals = n->batch_capacity;
+    literals = n->batch_literals;
+    ends = n->batch_ends;
+  } else {
+    max_clauses = batch->clauses_capacity;
+    max_literals = batch->literals_capacity;
+    if (!max_clauses)
+      usage_error(n, "zero clauses capacity of batch");
+    if (max_clauses > INT_MAX)
+      max_clauses = INT_MAX;
+    literals = batch->literals;
+    ends = batch->ends;
+  }
+  size_t size = 0, end = 0;
+  while (size != max_clauses && next_clause(n)) {
+    const size_t clause_size = n->clause_size;
+    if (max_literals - end < clause_size) {
+      if (size) {
+        n->pending_clause = true;
+        break;
+      }
+      if (!owned)
+        usage_error(n, "clause with %zu literals exceeds batch capacity",
+                    clause_size);
+      n->batch_literals = literals =
+          reallocate(n, literals, clause_size, sizeof *literals,
+                     "batch literals");
+      n->batch_capacity = max_literals = clause_size;
+    }
+    memcpy(literals + end, n->clause, clause_size * sizeof *literals);
+    end += clause_size;
+    ends[size++] = end;
+  }
+  if (owned) {
+    batch->literals = literals;
+    batch->ends = ends;
+  }
+  batch->size = size;
+  return size;
+}
+
+static void check_options(struct normalizer *n) {
+  const struct options *opts = &n->opts;
+  if (opts->map_path && !opts->compact)
+    usage_error(n, "can not use '--map=%s' without '--compact'",
+                opts->map_path);
+  if (opts->index_path && opts->fingerprint)
+    usage_error(n, "can not combine '--index' and '--fingerprint'");
+  if ((opts->binary_output || opts->delta_output) && opts->gbd)
+    usage_error(n, "can not combine binary formats and '--gbd'");
+  if (opts->binary_output && opts->delta_output)
+    usage_error(n, "can not combine '--binary' and '--delta'");
+  if (opts->size_shards && (!n->output_path || n->output_file ||
+                            !strcmp(n->output_path, "-")))
+    usage_error(n, "sharding requires an output file path");
+  if (opts->size_shards &&
+      (opts->csr || opts->fingerprint || opts->index_path))
+    usage_error(n, "can not combine '--shards' with '--csr', "
+                   "'--fingerprint' or '--index'");
+  if (opts->size_shards && opts->shard_method == RANGE &&
+      (opts->dedup || opts->remove_tautologies || opts->fix_header ||
+       opts->sample_fraction || opts->sample_count))
+    usage_error(n, "can not combine '--shard-by=range' with '--dedup', "
+                   "'--remove-tautologies', '--fix-header' or '--sample'");
+  if (opts->csr && (opts->gbd || opts->binary_output ||
+                    opts->delta_output || opts->fingerprint ||
+                    opts->index_path))
+    usage_error(n, "can not combine '--csr' with other output formats or "
+                   "'--index'");
+}
+
+static void read_header(struct normalizer *n) {
+  if (n->header_parsed)
+    return;
+  if (!n->input_file)
+    usage_error(n, "no input file opened");
+  check_options(n);
+  parse_header(n);
+  PROBE3(header, bytes_read(n), n->variables, n->clauses);
+  n->header_parsed = true;
+  int variables = n->variables;
+  n->variables_capacity = variables + 1ul;
+  if (n->opts.compact)
+    n->map = allocate_zeroed(n, variables + 1ul, sizeof *n->map);
+  if (n->opts.occurrences_path)
+    n->occurrences =
+        allocate_zeroed(n, variables + 1ul, sizeof *n->occurrences);
+  else if (n->opts.features_path) {
+    n->used_size = variables / 8 + 1ul;
+    n->used = allocate_zeroed(n, n->used_size, 1);
+  }
+}
+
+static void start_body(struct normalizer *n) {
+  if (n->body_started)
+    usage_error(n, "input already parsed");
+  read_header(n);
+  n->body_started = true;
+  n->sorted.limit = n->opts.memory_limit;
+  start_sampling(n);
+}
+
+// The streaming interface delivers clauses one by one and thus can neither
+// sort nor deduplicate them.
+
+static void start_stream(struct normalizer *n) {
+  if (n->opts.sort_clauses || n->opts.dedup)
+    usage_error(n, "can not stream clauses with '--sort-clauses' or "
+                   "'--dedup'");
+  start_body(n);
+}
+
+static void start_output(struct normalizer *n) {
+  const struct options *opts = &n->opts;
+  if (!opts->size_shards && !n->output_file)
+    n->output_file =
+        open_output(n, n->output_path, &n->output_mode, &n->output_pid);
+  n->body_file = n->output_file;
+  if (opts->size_shards)
+    start_shards(n);
+  else if (opts->csr)
+    start_csr(n);
+  else if (opts->fingerprint) {
+    if (opts->fingerprint_rounds)
+      n->fingerprint_spool = open_temporary(n);
+  } else if (!opts->gbd) {
+    if (opts->compact || opts->remove_tautologies || opts->dedup ||
+        opts->fix_header || opts->sample_fraction || opts->sample_count)
+      n->body_file = open_spool(n);
+    else
+      n->header_bytes =
+          write_header(n, n->output_file, n->variables, n->clauses);
+  }
+}
+
+// Returns 'false' if closing the output failed.
+
+static bool close_files(struct normalizer *n) {
+  if (n->body_file == n->output_file)
+    n->body_file = 0;
+  if (n->close_input == 1)
+    fclose(n->input_file);
+  if (n->close_input == 2)
+    close_input_decompressor(n);
+  n->input_file = 0;
+  n->close_input = 0;
+  bool res = true;
+  if (n->output_file)
+    res = close_output(n->output_file, n->output_mode, n->output_pid,
+                       n->output_path);
+  n->output_file = 0;
+  n->output_mode = 0;
+  return res;
+}
+
+// Number of variables in the written header.
+
+static int header_variables(struct normalizer *n) {
+  const struct options *opts = &n->opts;
+  return opts->compact      ? n->mapped
+         : opts->fix_header ? n->max_variable
+                            : n->variables;
+}
+
+static void finish_output(struct normalizer *n) {
+  const struct options *opts = &n->opts;
+  int used_variables = header_variables(n);
+  if (opts->size_shards)
+    finish_shards(n, used_variables);
+  else if (n->body_file != n->output_file) {
+    n->header_bytes =
+        write_header(n, n->output_file, used_variables, n->emitted);
+    copy_spool(n, &n->body_file, n->output_file);
+  }
+  if (opts->csr)
+    finish_csr(n, used_variables);
+  if (opts->fingerprint || opts->hash) {
+    if (opts->fingerprint_rounds)
+      refine_fingerprint(n, used_variables);
+    uint64_t hash = n->fingerprint_sum + mix64(used_variables);
+    hash += hash_size(opts->size_shards ? n->total_emitted : n->emitted);
+    n->hash = mix64(hash);
+  }
+  if (opts->fingerprint)
+    n->written = fprintf(n->output_file, "%016" PRIx64 "\n", n->hash);
+  else if (!opts->size_shards && !opts->csr)
+    n->written = n->header_bytes + n->body_bytes;
+  if (n->output_file)
+    fflush(n->output_file);
+  if (opts->index_path)
+    write_index(n);
+  if (opts->map_path)
+    write_map(n, n->variables);
+  if (opts->features_path && opts->fix_header)
+    write_features(n, n->max_variable,
+                   opts->size_shards ? n->total_emitted : n->emitted);
+  else if (opts->features_path)
+    write_features(n, n->variables, n->clauses);
+  if (opts->occurrences_path)
+    write_occurrences(n, n->variables);
+  PROBE2(flush, bytes_read(n), n->parsed);
+  if (!close_files(n))
+    io_error(n, "writing output file '%s' failed", output_name(n));
+}
+
+static void run(struct normalizer *n) {
+  start_body(n);
+  start_output(n);
+  while (next_clause(n))
+    store_clause(n);
+  if (n->opts.sort_clauses)
+    write_sorted_clauses(n);
+  else if (n->opts.dedup && n->dedup_spilling)
+    write_spilled_clauses(n);
+  finish_output(n);
+}
+
+static void set_path(struct normalizer *n, char **path, const char *str) {
+  free(*path);
+  *path = 0;
+  *path = copy_string(n, str);
+}
+
+// Sample sizes are fractions ('0.1' or '10%') or clause counts ('1000' or
+// with size suffix as in '64k').
+
+static void parse_sample(struct normalizer *n, const char *arg,
+                         const char *str) {
+  struct options *opts = &n->opts;
+  opts->sample_fraction = 0;
+  opts->sample_count = 0;
+  if (!strchr(str, '.') && !strchr(str, '%')) {
+    opts->sample_count = parse_size(n, arg, str);
+    if (opts->sample_count > INT_MAX)
+      usage_error(n, "sample size too large in '%s'", arg);
+    return;
+  }
+  char *end;
+  double fraction = strtod(str, &end);
+  if (end != str && *end == '%')
+    fraction /= 100, end++;
+  if (end == str || *end || !(fraction > 0 && fraction <= 1))
+    usage_error(n, "invalid sample fraction in '%s'", arg);
+  opts->sample_fraction = fraction;
+}
+
+// Parses a positive decimal number not larger than 'max' strictly.
+
+static unsigned long long parse_number(struct normalizer *n, const char *arg,
+                                       const char *str,
+                                       unsigned long long max,
+                                       const char *what) {
+  char *end;
+  errno = 0;
+  unsigned long long res = strtoull(str, &end, 10);
+  if (!isdigit((unsigned char) *str) || *end || errno || !res || res > max)
+    usage_error(n, "invalid %s in '%s'", what, arg);
+  return res;
+}
+
+static uint64_t parse_seed(struct normalizer *n, const char *arg,
+                           const char *str) {
+  char *end;
+  errno = 0;
+  unsigned long long res = strtoull(str, &end, 0);
+  if (end == str || *end || errno || *str == '-')
+    usage_error(n, "invalid seed in '%s'", arg);
+  return res;
+}
+
+static void parse_option(struct normalizer *n, const char *arg) {
+  struct options *opts = &n->opts;
+  const char *value;
+  if (!strcmp(arg, "-g") || !strcmp(arg, "--gbd"))
+    opts->gbd = true;
+  else if ((value = has_prefix(arg, "--features=")))
+    set_path(n, &opts->features_path, value);
+  else if ((value = has_prefix(arg, "--occurrences=")))
+    set_path(n, &opts->occurrences_path, value);
+  else if (!strcmp(arg, "--compact"))
+    opts->compact = true;
+  else if ((value = has_prefix(arg, "--map=")))
+    set_path(n, &opts->map_path, value);
+  else if (!strcmp(arg, "--sort-literals"))
+    opts->sort_literals = true;
+  else if (!strcmp(arg, "--remove-tautologies"))
+    opts->sort_literals = opts->remove_tautologies = true;
+  else if (!strcmp(arg, "--sort-clauses"))
+    opts->sort_literals = opts->sort_clauses = true;
+  else if (!strcmp(arg, "--dedup"))
+    opts->sort_literals = opts->dedup = true;
+  else if ((value = has_prefix(arg, "--index=")))
+    set_path(n, &opts->index_path, value);
+  else if ((value = has_prefix(arg, "--index-block="))) {
+    opts->index_block = parse_number(n, arg, value, INT_MAX, "block size");
+  } else if (!strcmp(arg, "--binary"))
+    opts->binary_output = true;
+  else if (!strcmp(arg, "--csr"))
+    opts->csr = true;
+  else if ((value = has_prefix(arg, "--shards="))) {
+    opts->size_shards =
+        parse_number(n, arg, value, INT_MAX, "number of shards");
+  } else if (!strcmp(arg, "--shard-by=round-robin"))
+    opts->shard_method = ROUND_ROBIN;
+  else if (!strcmp(arg, "--shard-by=range"))
+    opts->shard_method = RANGE;
+  else if (!strcmp(arg, "--shard-by=hash"))
+    opts->shard_method = HASH;
+  else if (!strcmp(arg, "--delta"))
+    opts->sort_literals = opts->delta_output = true;
+  else if (!strcmp(arg, "--fix-header"))
+    opts->fix_header = true;
+  else if (!strcmp(arg, "--hash"))
+    opts->hash = true;
+  else if (!strcmp(arg, "--fingerprint"))
+    opts->fingerprint = true;
+  else if ((value = has_prefix(arg, "--fingerprint="))) {
+    opts->fingerprint = true;
+    opts->fingerprint_rounds =
+        parse_number(n, arg, value, INT_MAX, "number of rounds");
+  } else if ((value = has_prefix(arg, "--sample=")))
+    parse_sample(n, arg, value);
+  else if ((value = has_prefix(arg, "--seed=")))
+    opts->seed = parse_seed(n, arg, value);
+  else if ((value = has_prefix(arg, "--memory-limit=")))
+    opts->memory_limit = parse_size(n, arg, value);
+  else if ((value = has_prefix(arg, "--temp-dir=")))
+    set_path(n, &opts->temp_dir, value);
+  else
+    usage_error(n, "invalid option '%s'", arg);
+}
+
+static void open_input(struct normalizer *n, const char *path) {
+  if (n->input_file)
+    usage_error(n, "input file already opened");
+  FILE *file;
+  int mode;
+  if (!path || !strcmp(path, "-")) {
+    file = stdin;
+    path = "<stdin>";
+    mode = 0;
+  } else if (!exists_file(path))
+    io_error(n, "input file '%s' does not exist", path);
+  else if (has_suffix(path, ".xz")) {
+    file = open_decompressor(path, &n->input_pid);
+    mode = 2;
+  } else {
+    file = fopen(path, "r");
+    mode = 1;
+  }
+  if (!file)
+    io_error(n, "can not read input file '%s'", path);
+  n->input_file = file;
+  n->close_input = mode;
+  set_path(n, &n->input_path, path);
+  PROBE2(open, n->input_path, mode);
+}
+
+static void release_file(struct normalizer *n) {
+  if (n->body_file && n->body_file != n->output_file && !n->shards)
+    fclose(n->body_file);
+  n->body_file = 0;
+  close_files(n);
+  free(n->spool_buffer);
+  if (n->runs)
+    for (size_t i = 0; i != n->size_runs; i++)
+      if (n->runs[i])
+        fclose(n->runs[i]);
+  release_mergers(n);
+  free(n->runs);
+  if (n->pending_run)
+    fclose(n->pending_run);
+  if (n->fingerprint_spool)
+    fclose(n->fingerprint_spool);
+  if (n->fingerprint_merger.run)
+    fclose(n->fingerprint_merger.run);
+  free(n->fingerprint_merger.clause);
+  if (n->sample_spool)
+    fclose(n->sample_spool);
+  free(n->sample_merger.clause);
+  if (n->csr_offsets)
+    fclose(n->csr_offsets);
+  if (n->shards)
+    for (unsigned i = 0; i != n->opts.size_shards; i++)
+      if (n->shards[i].file)
+        fclose(n->shards[i].file);
+  free(n->shards);
+  if (n->shard_file)
+    close_output(n->shard_file, n->shard_mode, n->shard_pid, n->shard_path);
+  free(n->shard_path);
+  free(n->input_path);
+  free(n->output_path);
+  free(n->histogram);
+  free(n->occurrences);
+  free(n->used);
+  free(n->map);
+  free(n->blocks);
+  free(n->previous);
+  for (unsigned level = 0; level != MAX_LEVELS; level++)
+    for (unsigned i = 0; i != PARTITIONS; i++)
+      if (n->partitions[level][i])
+        fclose(n->partitions[level][i]);
+  free(n->partition_merger.clause);
+  free(n->color);
+  free(n->next_color);
+}
+
+// These buffers are kept when the context is reset for the next file.
+
+#define REUSABLE_BUFFERS \
+  REUSE(int *, clause) \
+  REUSE(size_t, clause_capacity) \
+  REUSE(unsigned *, keys) \
+  REUSE(unsigned *, tmp_keys) \
+  REUSE(size_t, keys_capacity) \
+  REUSE(int *, batch_literals) \
+  REUSE(size_t *, batch_ends) \
+  REUSE(size_t, batch_capacity) \
+  REUSE(struct arena, sorted) \
+  REUSE(const int **, starts) \
+  REUSE(size_t, starts_capacity) \
+  REUSE(struct arena, hashed) \
+  REUSE(const int **, table) \
+  REUSE(size_t, table_capacity) \
+  REUSE(struct sample *, reservoir) \
+  REUSE(size_t, reservoir_capacity) \
+  REUSE(struct arena, samples) \
+  REUSE(struct arena, spare_samples)
+
+static void release_buffers(struct normalizer *n) {
+  free(n->clause);
+  free(n->batch_literals);
+  free(n->batch_ends);
+  free(n->keys);
+  free(n->tmp_keys);
+  release_arena(&n->sorted);
+  free(n->starts);
+  release_arena(&n->hashed);
+  free(n->table);
+  free(n->reservoir);
+  release_arena(&n->samples);
+  release_arena(&n->spare_samples);
+}
+
+static void reset(struct normalizer *n) {
+  release_file(n);
+#define REUSE(TYPE, NAME) TYPE NAME = n->NAME;
+  REUSABLE_BUFFERS
+#undef REUSE
+  const size_t offset = offsetof(struct normalizer, status);
+  memset((char *) n + offset, 0, sizeof *n - offset);
+#define REUSE(TYPE, NAME) n->NAME = NAME;
+  REUSABLE_BUFFERS
+#undef REUSE
+  reset_arena(&n->sorted);
+  reset_arena(&n->hashed);
+  reset_arena(&n->samples);
+  if (n->table)
+    memset(n->table, 0, n->table_capacity * sizeof *n->table);
+}
+
+// The public functions record errors through 'longjmp' to this guard.
+
+#define GUARD(N) \
+  do { \
+    if ((N)->status) \
+      return (N)->status; \
+    if (setjmp((N)->jump)) \
+      return (N)->status; \
+  } while (0)
+
+static void release_options(struct normalizer *n) {
+  free(n->opts.features_path);
+  free(n->opts.occurrences_path);
+  free(n->opts.map_path);
+  free(n->opts.index_path);
+  free(n->opts.temp_dir);
+}
+
+static void default_options(struct normalizer *n) {
+  memset(&n->opts, 0, sizeof n->opts);
+  n->opts.index_block = 1024;
+  n->opts.memory_limit = (size_t) 1 << 30;
+  n->opts.shard_method = ROUND_ROBIN;
+}
+
+normalizer *normalizer_new(void) {
+  struct normalizer *n = calloc(1, sizeof *n);
+  if (!n)
+    return 0;
+  default_options(n);
+  return n;
+}
+
+void normalizer_delete(normalizer *n) {
+  release_file(n);
+  release_buffers(n);
+  release_options(n);
+  free(n);
+}
+
+void normalizer_reset(normalizer *n) { reset(n); }
+
+FILE *normalizer_open_decompressor(const char *path, pid_t *pid) {
+  return open_decompressor(path, pid);
+}
+
+int normalizer_close_decompressor(FILE *file, pid_t pid, int terminate) {
+  int status = close_decompressor(file, pid, terminate);
+  if (WIFEXITED(status) && !WEXITSTATUS(status))
+    return NORMALIZER_OK;
+  return NORMALIZER_IO_ERROR;
+}
+
+void normalizer_reset_options(normalizer *n) {
+  release_options(n);
+  default_options(n);
+}
+
+int normalizer_option(normalizer *n, const char *option) {
+  GUARD(n);
+  parse_option(n, option);
+  return NORMALIZER_OK;
+}
+
+int normalizer_open_input(normalizer *n, const char *path) {
+  GUARD(n);
+  open_input(n, path);
+  return NORMALIZER_OK;
+}
+
+int normalizer_open_output(normalizer *n, const char *path) {
+  GUARD(n);
+  if (n->output_path || n->output_file)
+    usage_error(n, "output file already specified");
+  if (path)
+    set_path(n, &n->output_path, path);
+  return NORMALIZER_OK;
+}
+
+int normalizer_attach_input(normalizer *n, FILE *file, const char *name) {
+  GUARD(n);
+  if (n->input_file)
+    usage_error(n, "input file already opened");
+  n->input_file = file;
+  n->close_input = 0;
+  set_path(n, &n->input_path, name);
+  return NORMALIZER_OK;
+}
+
+int normalizer_attach_output(normalizer *n, FILE *file, const char *name) {
+  GUARD(n);
+  if (n->output_path || n->output_file)
+    usage_error(n, "output file already specified");
+  n->output_file = file;
+  n->output_mode = 0;
+  set_path(n, &n->output_path, name);
+  return NORMALIZER_OK;
+}
+
+int normalizer_run(normalizer *n) {
+  GUARD(n);
+  run(n);
+  return NORMALIZER_OK;
+}
+
+int normalizer_header(normalizer *n, int *variables, int *clauses) {
+  GUARD(n);
+  read_header(n);
+  if (variables)
+    *variables = n->body_parsed ? header_variables(n) : n->variables;
+  if (clauses)
+    *clauses = n->body_parsed ? n->emitted : n->clauses;
+  return NORMALIZER_OK;
+}
+
+int normalizer_next_clause(normalizer *n, const int **literals,
+                           size_t *size) {
+  GUARD(n);
+  if (!n->body_started)
+    start_stream(n);
+  if (!next_clause(n))
+    return 0;
+  n->emitted++;
+  *literals = n->clause;
+  *size = n->clause_size;
+  return 1;
+}
+
+int normalizer_parse(normalizer *n, normalizer_clause_callback callback,
+                     void *state) {
+  GUARD(n);
+  start_stream(n);
+  while (next_clause(n)) {
+    n->emitted++;
+    if (callback(state, n->clause, n->clause_size))
+      break;
+  }
+  return NORMALIZER_OK;
+}
+
+int normalizer_next_batch(normalizer *n, normalizer_batch *batch) {
+  GUARD(n);
+  if (!n->body_started)
+    start_stream(n);
+  size_t size = next_batch(n, batch);
+  n->emitted += size;
+  return size;
+}
+
+void normalizer_statistics(normalizer *n, normalizer_stats *stats) {
+  stats->variables = n->variables;
+  stats->clauses = n->clauses;
+  stats->parsed = n->parsed;
+  stats->emitted = n->opts.size_shards ? n->total_emitted : n->emitted;
+  stats->bytes_read = bytes_read(n);
+  stats->bytes_written = n->written;
+  stats->spills = n->spills;
+  stats->hash = n->hash;
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    stats->peak_rss = 0;
+  else
+    stats->peak_rss = usage.ru_maxrss * (size_t) 1024;
+}
+
+void normalizer_print_statistics(normalizer *n, FILE *file) {
+  normalizer_stats stats;
+  normalizer_statistics(n, &stats);
+  fprintf(file, "c variables %d\n", stats.variables);
+  fprintf(file, "c clauses %d\n", stats.clauses);
+  fprintf(file, "c parsed %d\n", stats.parsed);
+  fprintf(file, "c emitted %d\n", stats.emitted);
+  fprintf(file, "c bytes-read %zu\n", stats.bytes_read);
+  fprintf(file, "c bytes-written %zu\n", stats.bytes_written);
+  fprintf(file, "c spills %zu\n", stats.spills);
+  if (n->opts.fingerprint || n->opts.hash)
+    fprintf(file, "c hash %016" PRIx64 "\n", stats.hash);
+  fprintf(file, "c peak-rss %.1f MB\n",
+          stats.peak_rss / (double) (1 << 20));
+}
+
+const char *normalizer_error(normalizer *n) { return n->error; }
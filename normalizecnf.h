@@ -0,0 +1,132 @@
+#ifndef _normalizecnf_h_INCLUDED
+#define _normalizecnf_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Library interface of 'normalize-cnf' ('libnormalizecnf').  All state is
+// kept in a 'normalizer' context, thus different contexts can be used
+// concurrently in different threads.  Functions returning 'int' return
+// 'NORMALIZER_OK' (zero) or one of the negative error codes below, and then
+// 'normalizer_error' gives the error message.  After an error the context
+// can only be reset or deleted.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+typedef struct normalizer normalizer;
+
+enum normalizer_status {
+  NORMALIZER_OK = 0,
+  NORMALIZER_PARSE_ERROR = -1,   // syntax error or invalid input
+  NORMALIZER_IO_ERROR = -2,      // can not open, read or write files
+  NORMALIZER_MEMORY_ERROR = -3,  // out-of-memory
+  NORMALIZER_USAGE_ERROR = -4,   // invalid options or API usage
+};
+
+normalizer *normalizer_new(void);
+void normalizer_delete(normalizer *);
+
+// Resetting closes all files and prepares the context for the next file.
+// Options are kept and so are internal buffers for reuse (which avoids
+// allocating them again for every file in a batch of files).
+
+void normalizer_reset(normalizer *);
+
+// Restore the default options, e.g., to reuse a reset context for a file
+// which should be normalized with different options.
+
+void normalizer_reset_options(normalizer *);
+
+// Options are given as on the command line, e.g., "--dedup" or
+// "--memory-limit=1m" (see 'normalize-cnf --help').
+
+int normalizer_option(normalizer *, const char *option);
+
+// Input and output files are opened through paths, where "-" denotes
+// '<stdin>' respectively '<stdout>' and a '.xz' suffix compression through
+// an 'xz' pipe (a failing compressor is an I/O error of 'normalizer_run').
+// The output file is only created after the header has been parsed
+// successfully.  Alternatively already opened files can be attached,
+// which are not closed by the library.
+
+int normalizer_open_input(normalizer *, const char *path);
+int normalizer_open_output(normalizer *, const char *path);
+int normalizer_attach_input(normalizer *, FILE *, const char *name);
+int normalizer_attach_output(normalizer *, FILE *, const char *name);
+
+// The 'xz' decompressor used for input files is also available for other
+// files (without shell and thus without quoting issues).  Closing kills it
+// if 'terminate' is non-zero (to stop before the end of the file) and
+// returns 'NORMALIZER_IO_ERROR' if decompression did not succeed.
+
+FILE *normalizer_open_decompressor(const char *path, pid_t *);
+int normalizer_close_decompressor(FILE *, pid_t, int terminate);
+
+// Normalize the whole input and write the output (and all requested
+// auxiliary files like features and the variable map).
+
+int normalizer_run(normalizer *);
+
+// Streaming interface without writing output.  After parsing the header
+// each call to 'normalizer_next_clause' returns one if it parsed another
+// clause and zero at the end of the input.  The literals point into an
+// internal buffer, which is only valid until the next call.  Clauses are
+// delivered after sampling ('--sample'), renaming ('--compact') and
+// canonicalization ('--sort-literals' and '--remove-tautologies').  As
+// they can neither be sorted nor deduplicated '--sort-clauses' and
+// '--dedup' are usage errors.  At the end of the input 'normalizer_header'
+// returns the header which would have been written (after '--compact',
+// '--fix-header' and removing clauses) instead of the parsed one.  The
+// callback version stops if the callback returns non-zero.
+
+int normalizer_header(normalizer *, int *variables, int *clauses);
+int normalizer_next_clause(normalizer *, const int **literals,
+                           size_t *size);
+
+typedef int (*normalizer_clause_callback)(void *state, const int *literals,
+                                          size_t size);
+
+int normalizer_parse(normalizer *, normalizer_clause_callback, void *state);
+
+// Batched version of the streaming interface, which amortizes the call
+// overhead over many clauses.  It fills a flat array of literals, where
+// clause 'i' ends at 'ends[i]' (exclusive) and starts at 'ends[i-1]' (or
+// zero for the first clause), and returns the number of clauses in the
+// batch (which is also stored in 'size') or zero at the end of the input.
+// If 'literals_capacity' is zero the arrays are owned by the library and
+// reused by the next call.  Otherwise they are provided by the caller with
+// the given capacities and a clause is kept for the next call if it does
+// not fit anymore (it is an error if it does not fit into an empty batch).
+
+typedef struct normalizer_batch {
+  int *literals;
+  size_t *ends;
+  size_t size;
+  size_t literals_capacity, clauses_capacity;
+} normalizer_batch;
+
+int normalizer_next_batch(normalizer *, normalizer_batch *);
+
+// Statistics of the current (or last) file.  As memory usage is only
+// available per process the peak resident set size is process wide.
+
+typedef struct normalizer_stats {
+  int variables, clauses;       // in the (fixed) header
+  int parsed, emitted;          // clauses parsed and written
+  size_t bytes_read, bytes_written;
+  size_t spills;                // temporary files due to memory limit
+  uint64_t hash;                // '--fingerprint' or '--hash' (else zero)
+  size_t peak_rss;              // maximum resident set size in bytes
+} normalizer_stats;
+
+void normalizer_statistics(normalizer *, normalizer_stats *);
+
+// Print the statistics as 'c <name> <value>' lines.
+
+void normalizer_print_statistics(normalizer *, FILE *);
+
+const char *normalizer_error(normalizer *);
+
+#endif
@@ -0,0 +1,111 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+struct job {
+  struct job *next;
+  pool_job function;
+  void *data;
+};
+
+struct pool {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  struct job *first, *last;
+  bool stop;
+  unsigned size_workers;
+  pthread_t *workers;
+  int size_options;
+  char **options;
+};
+
+static void fatal(const char *msg) {
+  fprintf(stderr, "normalize: fatal error: %s\n", msg);
+  exit(1);
+}
+
+static struct job *dequeue_job(struct pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  while (!pool->first && !pool->stop)
+    pthread_cond_wait(&pool->wake, &pool->lock);
+  struct job *job = pool->first;
+  if (job && !(pool->first = job->next))
+    pool->last = 0;
+  pthread_mutex_unlock(&pool->lock);
+  return job;
+}
+
+static void *work(void *ptr) {
+  struct pool *pool = ptr;
+  normalizer *n = normalizer_new();
+  if (!n)
+    fatal("out-of-memory allocating normalizer");
+  struct job *job;
+  while ((job = dequeue_job(pool))) {
+    normalizer_reset(n);
+    normalizer_reset_options(n);
+    for (int i = 0; i != pool->size_options; i++)
+      (void) normalizer_option(n, pool->options[i]);
+    job->function(n, job->data);
+    free(job);
+  }
+  normalizer_delete(n);
+  return 0;
+}
+
+pool *new_pool(unsigned workers, int size_options, char **options) {
+  struct pool *pool = calloc(1, sizeof *pool);
+  if (!pool || !(pool->workers = calloc(workers, sizeof *pool->workers)))
+    fatal("out-of-memory allocating worker pool");
+  pthread_mutex_init(&pool->lock, 0);
+  pthread_cond_init(&pool->wake, 0);
+  pool->size_options = size_options;
+  pool->options = options;
+  for (unsigned i = 0; i != workers; i++) {
+    if (pthread_create(pool->workers + i, 0, work, pool))
+      fatal("could not start worker thread");
+    pool->size_workers++;
+  }
+  return pool;
+}
+
+void submit_job(pool *pool, pool_job function, void *data) {
+  struct job *job = malloc(sizeof *job);
+  if (!job)
+    fatal("out-of-memory allocating job");
+  job->next = 0;
+  job->function = function;
+  job->data = data;
+  pthread_mutex_lock(&pool->lock);
+  if (pool->last)
+    pool->last->next = job;
+  else
+    pool->first = job;
+  pool->last = job;
+  pthread_cond_signal(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void delete_pool(pool *pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (unsigned i = 0; i != pool->size_workers; i++)
+    pthread_join(pool->workers[i], 0);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+unsigned default_workers(void) {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return processors > 0 ? processors : 1;
+}
@@ -0,0 +1,34 @@
+#ifndef _pool_h_INCLUDED
+#define _pool_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Pool of worker threads used by the long running modes of the command
+// line tool.  Each worker owns a 'normalizer' context which stays warm
+// across jobs, i.e., it is only reset (keeping its buffers) and gets the
+// default options of the pool before a job is processed.
+
+#include "normalizecnf.h"
+
+typedef struct pool pool;
+
+typedef void (*pool_job)(normalizer *, void *data);
+
+// The options are not copied and need to stay valid while the pool exists.
+// They should have been checked before (invalid options are ignored).
+
+pool *new_pool(unsigned workers, int size_options, char **options);
+
+// Jobs are processed in submission order by the first idle worker.
+
+void submit_job(pool *, pool_job, void *data);
+
+// Waits for all submitted jobs to finish.
+
+void delete_pool(pool *);
+
+// Number of online processors as default for the number of workers.
+
+unsigned default_workers(void);
+
+#endif
@@ -0,0 +1,215 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Every connection to the socket carries exactly one request, which is a
+// sequence of NUL terminated arguments as on the command line (options,
+// input and output) terminated by an empty argument.  Instead of paths the
+// client can pass open file descriptors ('SCM_RIGHTS'), which are used in
+// order for a missing or '-' input respectively output.  The response is
+// either 'ok' followed by the statistics lines of '--stats' or a single
+// 'error <status> <message>' line, after which the connection is closed.
+// Requests are received by the workers, so the whole request has to arrive
+// within 'REQUEST_TIMEOUT' seconds, as otherwise idle connections could
+// block all workers.
+
+#define _GNU_SOURCE
+
+#include "serve.h"
+#include "pool.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_REQUEST (1 << 16)
+#define MAX_DESCRIPTORS 2
+#define REQUEST_TIMEOUT 10
+
+struct request {
+  int socket;
+  char arguments[MAX_REQUEST];
+  int descriptors[MAX_DESCRIPTORS];
+  unsigned size_descriptors, used_descriptors;
+  FILE *input, *output;
+};
+
+static void receive_descriptors(struct request *r, struct msghdr *msg) {
+  for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+    if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+      continue;
+    size_t size = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int *descriptors = (int *) CMSG_DATA(c);
+    for (size_t i = 0; i != size; i++)
+      if (r->size_descriptors < MAX_DESCRIPTORS)
+        r->descriptors[r->size_descriptors++] = descriptors[i];
+      else
+        close(descriptors[i]);
+  }
+}
+
+// Returns zero if the connection was closed before the terminating empty
+// argument was received, if the request is too long or timed out.  Each
+// receive is limited by the timeout of the socket and we also check the
+// total time, since a client could send single bytes slowly.
+
+static size_t receive_request(struct request *r) {
+  time_t start = time(0);
+  size_t bytes = 0;
+  while (bytes < MAX_REQUEST && time(0) - start < REQUEST_TIMEOUT) {
+    union {
+      struct cmsghdr align;
+      char space[CMSG_SPACE(MAX_DESCRIPTORS * sizeof(int))];
+    } control;
+    struct iovec iov = {r->arguments + bytes, MAX_REQUEST - bytes};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof control.space;
+    ssize_t res = recvmsg(r->socket, &msg, MSG_CMSG_CLOEXEC);
+    if (res < 0 && errno == EINTR)
+      continue;
+    if (res <= 0)
+      return 0;
+    receive_descriptors(r, &msg);
+    bytes += res;
+    if (!r->arguments[bytes - 1] && (bytes == 1 || !r->arguments[bytes - 2]))
+      return bytes;
+  }
+  return 0;
+}
+
+static FILE *open_descriptor(struct request *r, const char *mode) {
+  if (r->used_descriptors == r->size_descriptors)
+    return 0;
+  FILE *file = fdopen(r->descriptors[r->used_descriptors], mode);
+  if (file)
+    r->used_descriptors++;
+  return file;
+}
+
+static int open_files(normalizer *n, struct request *r, const char **error) {
+  const char *input_path = 0, *output_path = 0;
+  for (const char *arg = r->arguments; *arg; arg += strlen(arg) + 1)
+    if (arg[0] == '-' && arg[1]) {
+      int res = normalizer_option(n, arg);
+      if (res)
+        return res;
+    } else if (output_path) {
+      *error = "too many files";
+      return NORMALIZER_USAGE_ERROR;
+    } else if (input_path)
+      output_path = arg;
+    else
+      input_path = arg;
+  int res;
+  if (input_path && strcmp(input_path, "-"))
+    res = normalizer_open_input(n, input_path);
+  else if ((r->input = open_descriptor(r, "r")))
+    res = normalizer_attach_input(n, r->input, "<descriptor>");
+  else {
+    *error = "missing input descriptor";
+    return NORMALIZER_USAGE_ERROR;
+  }
+  if (res)
+    return res;
+  if (output_path && strcmp(output_path, "-"))
+    return normalizer_open_output(n, output_path);
+  if ((r->output = open_descriptor(r, "w")))
+    return normalizer_attach_output(n, r->output, "<descriptor>");
+  *error = "missing output descriptor";
+  return NORMALIZER_USAGE_ERROR;
+}
+
+static void respond(normalizer *n, struct request *r, int res,
+                    const char *error) {
+  FILE *file = fdopen(r->socket, "w");
+  if (!file) {
+    close(r->socket);
+    return;
+  }
+  if (!res) {
+    fputs("ok\n", file);
+    normalizer_print_statistics(n, file);
+  } else
+    fprintf(file, "error %d %s\n", res, error ? error : normalizer_error(n));
+  fclose(file);
+}
+
+static void serve_request(normalizer *n, void *data) {
+  struct request *r = data;
+  const char *error = 0;
+  int res;
+  if (!receive_request(r)) {
+    error = "incomplete request";
+    res = NORMALIZER_USAGE_ERROR;
+  } else if (!(res = open_files(n, r, &error)))
+    res = normalizer_run(n);
+  if (r->output && fclose(r->output) && !res) {
+    error = "could not close output descriptor";
+    res = NORMALIZER_IO_ERROR;
+  }
+  if (r->input)
+    fclose(r->input);
+  for (unsigned i = r->used_descriptors; i != r->size_descriptors; i++)
+    close(r->descriptors[i]);
+  respond(n, r, res, error);
+  free(r);
+}
+
+int serve(const char *path, unsigned workers, int size_options,
+          char **options) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof address.sun_path) {
+    fprintf(stderr, "normalize: error: socket path '%s' too long\n", path);
+    return 1;
+  }
+  strcpy(address.sun_path, path);
+  int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    perror("normalize: error: could not create socket");
+    return 1;
+  }
+  struct stat st;
+  if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+    unlink(path);
+  if (bind(listener, (struct sockaddr *) &address, sizeof address) ||
+      listen(listener, SOMAXCONN)) {
+    fprintf(stderr, "normalize: error: could not listen on '%s': %s\n",
+            path, strerror(errno));
+    close(listener);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  pool *pool = new_pool(workers, size_options, options);
+  for (;;) {
+    int client = accept4(listener, 0, 0, SOCK_CLOEXEC);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fprintf(stderr, "normalize: error: accepting connection failed: %s\n",
+              strerror(errno));
+      break;
+    }
+    struct request *r = calloc(1, sizeof *r);
+    if (!r) {
+      close(client);
+      continue;
+    }
+    struct timeval timeout = {.tv_sec = REQUEST_TIMEOUT};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    r->socket = client;
+    submit_job(pool, serve_request, r);
+  }
+  delete_pool(pool);
+  close(listener);
+  unlink(path);
+  return 1;
+}
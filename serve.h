@@ -0,0 +1,13 @@
+#ifndef _serve_h_INCLUDED
+#define _serve_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Normalization daemon listening on a Unix domain socket ('--serve').  The
+// options are the defaults for all requests (see 'new_pool').  Only returns
+// (with a non-zero exit code) if the socket can not be set up.
+
+int serve(const char *path, unsigned workers, int size_options,
+          char **options);
+
+#endif
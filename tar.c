@@ -0,0 +1,337 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// The archive is read sequentially (so it can be a pipe from 'xz') in
+// blocks of 512 bytes.  Each member starts with a header block followed by
+// its data padded to full blocks.  We support POSIX 'ustar' headers with
+// name prefixes, GNU long names ('L') and the 'path' of 'pax' extended
+// headers ('x'), which covers archives produced by GNU and BSD 'tar'.  The
+// data of a regular member is given to the library as 'FILE' through a
+// cookie stream limited to the size of the member.  The context is reset
+// (and thus keeps its buffers) after each member.  The partial output of a
+// failed member is removed.
+
+#define _GNU_SOURCE
+
+#include "tar.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BLOCK 512
+#define MAX_NAME (1 << 16)
+
+struct member {
+  FILE *archive;
+  uint64_t remaining;
+};
+
+static ssize_t read_member(void *cookie, char *buffer, size_t size) {
+  struct member *m = cookie;
+  if (size > m->remaining)
+    size = m->remaining;
+  size_t bytes = fread(buffer, 1, size, m->archive);
+  m->remaining -= bytes;
+  if (bytes < size && ferror(m->archive))
+    return -1;
+  return bytes;
+}
+
+static bool skip_bytes(FILE *archive, uint64_t bytes) {
+  char buffer[1 << 14];
+  while (bytes) {
+    size_t size = bytes < sizeof buffer ? bytes : sizeof buffer;
+    if (fread(buffer, 1, size, archive) != size)
+      return false;
+    bytes -= size;
+  }
+  return true;
+}
+
+static uint64_t padding(uint64_t size) {
+  return (BLOCK - size % BLOCK) % BLOCK;
+}
+
+static bool parse_number(const unsigned char *p, size_t len, uint64_t *res) {
+  uint64_t value = 0;
+  if (*p & 0x80) {
+    value = *p & 0x7f;
+    for (size_t i = 1; i != len; i++)
+      value = (value << 8) | p[i];
+  } else {
+    size_t i = 0;
+    while (i != len && p[i] == ' ')
+      i++;
+    if (i == len || p[i] < '0' || p[i] > '7')
+      return false;
+    while (i != len && p[i] >= '0' && p[i] <= '7')
+      value = 8 * value + (p[i++] - '0');
+    if (i != len && p[i] && p[i] != ' ')
+      return false;
+  }
+  *res = value;
+  return true;
+}
+
+static bool valid_header(const unsigned char *block) {
+  uint64_t expected;
+  if (!parse_number(block + 148, 8, &expected))
+    return false;
+  uint64_t sum = 0;
+  for (size_t i = 0; i != BLOCK; i++)
+    sum += (i >= 148 && i < 156) ? ' ' : block[i];
+  return sum == expected;
+}
+
+static bool zero_block(const unsigned char *block) {
+  for (size_t i = 0; i != BLOCK; i++)
+    if (block[i])
+      return false;
+  return true;
+}
+
+static char *header_name(const unsigned char *block) {
+  char *res = malloc(257);
+  if (!res)
+    return 0;
+  const char *name = (const char *) block, *prefix = name + 345;
+  if (!memcmp(block + 257, "ustar", 6) && *prefix)
+    snprintf(res, 257, "%.155s/%.100s", prefix, name);
+  else
+    snprintf(res, 257, "%.100s", name);
+  return res;
+}
+
+// Extended 'pax' headers consist of '<length> <key>=<value>\n' records.
+
+static char *pax_path(char *data, size_t size) {
+  char *p = data, *end = data + size;
+  while (p < end) {
+    char *q;
+    unsigned long length = strtoul(p, &q, 10);
+    if (q == p || *q != ' ' || !length || length > (size_t) (end - p))
+      return 0;
+    char *record = q + 1, *next = p + length;
+    if (next - record > 5 && !memcmp(record, "path=", 5) && next[-1] == '\n') {
+      size_t bytes = next - record - 6;
+      char *res = malloc(bytes + 1);
+      if (res) {
+        memcpy(res, record + 5, bytes);
+        res[bytes] = 0;
+      }
+      return res;
+    }
+    p = next;
+  }
+  return 0;
+}
+
+// Member names are relative to the output directory.  Leading '/' and './'
+// are dropped and names with '..' components rejected.
+
+static const char *relative_name(const char *name) {
+  for (;;)
+    if (*name == '/')
+      name++;
+    else if (name[0] == '.' && name[1] == '/')
+      name += 2;
+    else
+      break;
+  for (const char *p = name; *p;) {
+    if (p[0] == '.' && p[1] == '.' && (!p[2] || p[2] == '/'))
+      return 0;
+    while (*p && *p != '/')
+      p++;
+    while (*p == '/')
+      p++;
+  }
+  return *name ? name : 0;
+}
+
+static char *output_path(const char *output_dir, const char *name) {
+  size_t size = strlen(output_dir) + strlen(name) + 2;
+  char *res = malloc(size);
+  if (!res)
+    return 0;
+  snprintf(res, size, "%s/%s", output_dir, name);
+  for (char *p = res + strlen(output_dir) + 1; *p; p++)
+    if (*p == '/') {
+      *p = 0;
+      int failed = mkdir(res, 0777) && errno != EEXIST;
+      *p = '/';
+      if (failed)
+        break;
+    }
+  return res;
+}
+
+static bool normalize_member(normalizer *n, struct member *m,
+                             const char *name, const char *output_dir,
+                             bool stats) {
+  const char *relative = relative_name(name);
+  if (!relative) {
+    fprintf(stderr, "normalize: error: invalid member name '%s'\n", name);
+    return false;
+  }
+  size_t length = strlen(relative);
+  if (length > 3 && !strcmp(relative + length - 3, ".xz")) {
+    fprintf(stderr,
+            "normalize: error: compressed member '%s' not supported\n",
+            name);
+    return false;
+  }
+  char *path = output_path(output_dir, relative);
+  cookie_io_functions_t functions = {.read = read_member};
+  FILE *file = path ? fopencookie(m, "r", functions) : 0;
+  bool res = false;
+  if (!file)
+    fprintf(stderr, "normalize: error: out-of-memory reading '%s'\n", name);
+  else if (normalizer_attach_input(n, file, name) ||
+           normalizer_open_output(n, path))
+    fprintf(stderr, "normalize: error in '%s': %s\n", name,
+            normalizer_error(n));
+  else if (normalizer_run(n)) {
+    fprintf(stderr, "normalize: error in '%s': %s\n", name,
+            normalizer_error(n));
+    if (unlink(path) && errno != ENOENT)
+      fprintf(stderr, "normalize: error: could not remove '%s'\n", path);
+  } else {
+    normalizer_stats s;
+    normalizer_statistics(n, &s);
+    printf("%s %016" PRIx64 "\n", name, s.hash);
+    fflush(stdout);
+    if (stats)
+      normalizer_print_statistics(n, stderr);
+    res = true;
+  }
+  if (file)
+    fclose(file);
+  free(path);
+  normalizer_reset(n);
+  return res;
+}
+
+static FILE *open_archive(const char *path, int *mode, pid_t *pid) {
+  if (!path || !strcmp(path, "-")) {
+    *mode = 0;
+    return stdin;
+  }
+  size_t length = strlen(path);
+  if (length > 3 && !strcmp(path + length - 3, ".xz")) {
+    struct stat st;
+    if (stat(path, &st))
+      return 0;
+    *mode = 2;
+    return normalizer_open_decompressor(path, pid);
+  }
+  *mode = 1;
+  return fopen(path, "r");
+}
+
+bool is_tar_path(const char *path) {
+  size_t length = strlen(path);
+  return (length > 4 && !strcmp(path + length - 4, ".tar")) ||
+         (length > 7 && !strcmp(path + length - 7, ".tar.xz"));
+}
+
+int normalize_tar(normalizer *n, const char *archive,
+                  const char *output_dir, bool stats) {
+  struct stat st;
+  if (!output_dir || stat(output_dir, &st) || !S_ISDIR(st.st_mode)) {
+    fprintf(stderr, "normalize: error: tar input requires an existing "
+                    "output directory\n");
+    return 1;
+  }
+  const char *archive_name = archive ? archive : "<stdin>";
+  int mode;
+  pid_t pid;
+  FILE *file = open_archive(archive, &mode, &pid);
+  if (!file) {
+    fprintf(stderr, "normalize: error: can not read archive '%s'\n",
+            archive_name);
+    return 1;
+  }
+  if (normalizer_option(n, "--hash")) {
+    fprintf(stderr, "normalize: error: %s\n", normalizer_error(n));
+    return 1;
+  }
+  const char *error = 0;
+  unsigned failed = 0;
+  char *long_name = 0;
+  unsigned char block[BLOCK];
+  for (;;) {
+    size_t bytes = fread(block, 1, BLOCK, file);
+    if (!bytes)
+      break;
+    if (bytes != BLOCK) {
+      error = "truncated archive";
+      break;
+    }
+    if (zero_block(block))
+      break;
+    uint64_t size;
+    if (!valid_header(block) || !parse_number(block + 124, 12, &size)) {
+      error = "invalid tar header";
+      break;
+    }
+    char type = block[156];
+    if (type == 'L' || type == 'x') {
+      char *data = size < MAX_NAME ? malloc(size + 1) : 0;
+      if (!data) {
+        error = "invalid extended header";
+        break;
+      }
+      if (fread(data, 1, size, file) != size ||
+          !skip_bytes(file, padding(size))) {
+        free(data);
+        error = "truncated archive";
+        break;
+      }
+      data[size] = 0;
+      if (type == 'x') {
+        char *path = pax_path(data, size);
+        free(data);
+        if (!path)
+          continue;
+        data = path;
+      }
+      free(long_name);
+      long_name = data;
+      continue;
+    }
+    char *name = long_name ? long_name : header_name(block);
+    long_name = 0;
+    struct member m = {file, size};
+    if (!name)
+      error = "out-of-memory";
+    else if ((type == '0' || type == '7' || !type) &&
+             !normalize_member(n, &m, name, output_dir, stats))
+      failed++;
+    free(name);
+    if (error)
+      break;
+    if (!skip_bytes(file, m.remaining + padding(size))) {
+      error = "truncated archive";
+      break;
+    }
+  }
+  free(long_name);
+  if (mode == 1)
+    fclose(file);
+  else if (mode == 2) {
+    // Consume the zero blocks padding the archive after its end to let
+    // 'xz' finish successfully, unless we stop early due to an error.
+    while (!error && fread(block, 1, BLOCK, file))
+      ;
+    if (normalizer_close_decompressor(file, pid, error != 0) && !error)
+      error = "decompressing archive failed";
+  }
+  if (error)
+    fprintf(stderr, "normalize: error in '%s': %s\n", archive_name, error);
+  return error || failed;
+}
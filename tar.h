@@ -0,0 +1,19 @@
+#ifndef _tar_h_INCLUDED
+#define _tar_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Normalize all regular files in a tar archive (read as stream) to files
+// with the same relative path in the output directory.  Returns the exit
+// code (non-zero if the archive is invalid or a member failed).
+
+#include "normalizecnf.h"
+
+#include <stdbool.h>
+
+bool is_tar_path(const char *path);
+
+int normalize_tar(normalizer *, const char *archive, const char *output_dir,
+                  bool stats);
+
+#endif
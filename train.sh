@@ -0,0 +1,71 @@
+#!/bin/sh
+
+# Generates a small benchmark corpus and runs the given (instrumented)
+# binary on it in all modes.  This is used by './configure --pgo' to
+# collect the profile for profile-guided optimization.
+
+binary="$1"
+if [ ! -x "$binary" ]
+then
+  echo "usage: train.sh <binary>"
+  exit 1
+fi
+dir=`mktemp -d /tmp/normalize-cnf-train-XXXXXX`
+trap "rm -rf $dir" EXIT
+
+generate () {
+  awk -v seed=$1 -v variables=$2 -v clauses=$3 -v size=$4 \
+      -v comments=$5 -v crlf=$6 'BEGIN {
+    srand(seed)
+    eol = crlf ? "\r\n" : "\n"
+    printf "c generated by train.sh%s", eol
+    printf "p cnf %d %d%s", variables, clauses, eol
+    for (i = 0; i < clauses; i++) {
+      if (comments && rand() < 0.01)
+        printf "c comment %d%s", i, eol
+      k = size ? size : 1 + int(rand() * 12)
+      for (j = 0; j < k; j++) {
+        lit = 1 + int(rand() * variables)
+        if (rand() < 0.5)
+          lit = -lit
+        printf "%d%s", lit, (rand() < 0.9 ? " " : "\t")
+      }
+      printf "0%s", (rand() < 0.8 ? eol : " ")
+    }
+  }'
+}
+
+generate 1 100000 420000 3 0 0 > $dir/random3.cnf
+generate 2 20000 100000 0 1 0 > $dir/mixed.cnf
+generate 3 50000 100000 0 1 1 > $dir/crlf.cnf
+xz -1 -c $dir/mixed.cnf > $dir/mixed.cnf.xz
+
+for input in $dir/*.cnf $dir/*.cnf.xz
+do
+  "$binary" $input /dev/null || exit 1
+  "$binary" --gbd $input /dev/null || exit 1
+  "$binary" --features=/dev/null $input /dev/null || exit 1
+  "$binary" --occurrences=/dev/null $input /dev/null || exit 1
+  "$binary" --compact --map=/dev/null $input /dev/null || exit 1
+  "$binary" --remove-tautologies $input /dev/null || exit 1
+  "$binary" --sort-clauses --memory-limit=1m $input /dev/null || exit 1
+  "$binary" --dedup $input /dev/null || exit 1
+  "$binary" --dedup --memory-limit=64k --stats $input /dev/null 2>/dev/null || exit 1
+  "$binary" --fingerprint=2 $input /dev/null || exit 1
+  "$binary" --hash $input /dev/null || exit 1
+  "$binary" --sample=0.1 --compact $input /dev/null || exit 1
+  "$binary" --sample=1000 --seed=1 $input /dev/null || exit 1
+  "$binary" --compare $input $input >/dev/null || exit 1
+  "$binary" --fix-header --memory-limit=64k $input /dev/null || exit 1
+  "$binary" --index=/dev/null $input /dev/null || exit 1
+  "$binary" --binary $input $dir/binary.cnf || exit 1
+  "$binary" $dir/binary.cnf /dev/null || exit 1
+  "$binary" --csr $input $dir/output.csr || exit 1
+  "$binary" --delta $input $dir/delta.cnf || exit 1
+  "$binary" $dir/delta.cnf /dev/null || exit 1
+  "$binary" --shards=4 --shard-by=hash $input $dir/shard.cnf || exit 1
+done
+"$binary" $dir/mixed.cnf $dir/output.cnf.xz || exit 1
+mkdir $dir/members
+tar -C $dir -cf $dir/bundle.tar mixed.cnf crlf.cnf
+"$binary" $dir/bundle.tar $dir/members >/dev/null || exit 1
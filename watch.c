@@ -0,0 +1,153 @@
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Files are picked up as soon as they are closed after writing
+// ('IN_CLOSE_WRITE') or renamed into the directory ('IN_MOVED_TO'), while
+// hidden files (starting with '.') are ignored, so uploads can be written
+// to a hidden temporary file first and then renamed.  Files already in the
+// directory when starting are not normalized.  For each file the
+// statistics including the hash ('--hash') are written to '<name>.stats' in
+// the output directory and a line with the name and hash (or the error) is
+// printed.
+
+#include "watch.h"
+#include "pool.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct drop {
+  const char *dir, *output_dir;
+  char name[];
+};
+
+static char *join_path(const char *dir, const char *name,
+                       const char *suffix) {
+  size_t size = strlen(dir) + strlen(name) + strlen(suffix) + 2;
+  char *res = malloc(size);
+  if (res)
+    snprintf(res, size, "%s/%s%s", dir, name, suffix);
+  return res;
+}
+
+static void write_statistics(normalizer *n, struct drop *d) {
+  char *path = join_path(d->output_dir, d->name, ".stats");
+  FILE *file = path ? fopen(path, "w") : 0;
+  if (file) {
+    normalizer_print_statistics(n, file);
+    fclose(file);
+  } else
+    fprintf(stderr, "normalize: error: could not write '%s/%s.stats'\n",
+            d->output_dir, d->name);
+  free(path);
+}
+
+// A failed file leaves neither a partial output nor the statistics of a
+// previous file with the same name behind.
+
+static void remove_output(struct drop *d, const char *output) {
+  char *path = join_path(d->output_dir, d->name, ".stats");
+  if (unlink(output) && errno != ENOENT)
+    fprintf(stderr, "normalize: error: could not remove '%s'\n", output);
+  if (path)
+    unlink(path);
+  free(path);
+}
+
+static void normalize_drop(normalizer *n, void *data) {
+  struct drop *d = data;
+  char *input = join_path(d->dir, d->name, "");
+  char *output = join_path(d->output_dir, d->name, "");
+  if (!input || !output)
+    fprintf(stderr, "normalize: error: out-of-memory normalizing '%s'\n",
+            d->name);
+  else if (normalizer_option(n, "--hash") ||
+           normalizer_open_input(n, input) ||
+           normalizer_open_output(n, output))
+    fprintf(stderr, "normalize: error in '%s': %s\n", input,
+            normalizer_error(n));
+  else if (normalizer_run(n)) {
+    fprintf(stderr, "normalize: error in '%s': %s\n", input,
+            normalizer_error(n));
+    remove_output(d, output);
+  } else {
+    normalizer_stats stats;
+    normalizer_statistics(n, &stats);
+    write_statistics(n, d);
+    printf("%s %016" PRIx64 "\n", input, stats.hash);
+    fflush(stdout);
+  }
+  free(input);
+  free(output);
+  free(d);
+}
+
+int watch(const char *dir, const char *output_dir, unsigned workers,
+          int size_options, char **options) {
+  struct stat st, output_st;
+  if (stat(output_dir, &output_st) || !S_ISDIR(output_st.st_mode)) {
+    fprintf(stderr, "normalize: error: invalid output directory '%s'\n",
+            output_dir);
+    return 1;
+  }
+  if (!stat(dir, &st) && st.st_dev == output_st.st_dev &&
+      st.st_ino == output_st.st_ino) {
+    fprintf(stderr, "normalize: error: can not write output to watched "
+                    "directory '%s'\n", dir);
+    return 1;
+  }
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+                                              IN_ONLYDIR) < 0) {
+    fprintf(stderr, "normalize: error: can not watch '%s': %s\n", dir,
+            strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  pool *pool = new_pool(workers, size_options, options);
+  char buffer[1 << 16]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t bytes = read(fd, buffer, sizeof buffer);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0) {
+      fprintf(stderr, "normalize: error: watching '%s' failed: %s\n", dir,
+              bytes ? strerror(errno) : "end-of-file");
+      break;
+    }
+    for (char *p = buffer; p < buffer + bytes;) {
+      const struct inotify_event *event = (struct inotify_event *) p;
+      p += sizeof *event + event->len;
+      if (event->mask & IN_Q_OVERFLOW)
+        fprintf(stderr, "normalize: warning: events of '%s' lost\n", dir);
+      if (event->mask & IN_IGNORED) {
+        fprintf(stderr, "normalize: error: stopped watching '%s'\n", dir);
+        goto DONE;
+      }
+      if (event->mask & IN_ISDIR || !event->len || event->name[0] == '.')
+        continue;
+      size_t size = strlen(event->name) + 1;
+      struct drop *d = malloc(sizeof *d + size);
+      if (!d) {
+        fprintf(stderr, "normalize: error: out-of-memory watching '%s'\n",
+                dir);
+        goto DONE;
+      }
+      d->dir = dir;
+      d->output_dir = output_dir;
+      memcpy(d->name, event->name, size);
+      submit_job(pool, normalize_drop, d);
+    }
+  }
+DONE:
+  delete_pool(pool);
+  close(fd);
+  return 1;
+}
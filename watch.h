@@ -0,0 +1,14 @@
+#ifndef _watch_h_INCLUDED
+#define _watch_h_INCLUDED
+
+// Copyright (c), 2023-2025, Armin Biere, University of Freiburg.
+
+// Watch a directory ('--watch') and normalize every file written to it or
+// moved into it to a file with the same name in the output directory.  The
+// options are used for all files (see 'new_pool').  Only returns (with a
+// non-zero exit code) if watching fails.
+
+int watch(const char *dir, const char *output_dir, unsigned workers,
+          int size_options, char **options);
+
+#endif